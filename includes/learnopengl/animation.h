@@ -2,19 +2,25 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
 #include <learnopengl/bone.h>
-#include <functional>
+#include <learnopengl/clip_compression.h>
 #include <learnopengl/animdata.h>
+#include <learnopengl/baked_asset.h>
 #include <learnopengl/model_animation.h>
 
-struct AssimpNodeData
+/* Node hierarchy flattened in preorder, so every parent comes before its children
+   and a pose can be evaluated in one forward loop. Stored as parallel arrays indexed
+   by node index. */
+struct Skeleton
 {
-	glm::mat4 transformation;
-	std::string name;
-	int childrenCount;
-	std::vector<AssimpNodeData> children;
+	std::vector<std::string> names;
+	std::vector<int> parents;	// -1 for the root
+	std::vector<glm::mat4> transformations;	// bind-pose local transform of each node
+
+	inline int GetNodeCount() const { return (int)parents.size(); }
 };
 
 class Animation
@@ -22,18 +28,81 @@ class Animation
 public:
 	Animation() = default;
 
+	/* The clip is baked next to animationPath on first load; later loads read the
+	   skeleton and key tracks from the bake and skip Assimp entirely. */
 	Animation(const std::string& animationPath, Model* model)
 	{
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
-		assert(scene && scene->mRootNode);
-		auto animation = scene->mAnimations[0];
-		m_Duration = animation->mDuration;
-		m_TicksPerSecond = animation->mTicksPerSecond;
-		aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
-		globalTransformation = globalTransformation.Inverse();
-		ReadHierarchyData(m_RootNode, scene->mRootNode);
-		ReadMissingBones(animation, *model);
+		std::string bakePath = animationPath + ".anim.bake";
+		if (!LoadBaked(animationPath, bakePath, *model))
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
+			assert(scene && scene->mRootNode);
+			auto animation = scene->mAnimations[0];
+			m_Duration = animation->mDuration;
+			m_TicksPerSecond = animation->mTicksPerSecond;
+			ReadHierarchyData(scene->mRootNode, -1);
+			ReadMissingBones(animation, *model);
+			SaveBaked(animationPath, bakePath);
+		}
+		ResolveNodeBindings();
+		if (compression.enabled)
+		{
+			ClipCompressionStats stats = Compress(compression);
+			std::cout << "ANIMATION::COMPRESS " << animationPath << " " << stats.bytesBefore / 1024.0 << " KB -> "
+				<< stats.bytesAfter / 1024.0 << " KB, " << stats.keysBefore << " -> " << stats.keysAfter << " keys, "
+				<< stats.constantTracks << " of " << stats.tracks << " tracks constant, max joint error "
+				<< stats.maxJointError << std::endl;
+		}
+	}
+
+	// applied to every clip loaded from now on; the bake keeps the uncompressed keys
+	static inline ClipCompressionSettings compression;
+
+	/* Compresses the key tracks of every channel, see clip_compression.h, and measures
+	   the result: every joint of the skeleton is evaluated in model space with and
+	   without compression at twice the densest key rate, and the largest distance
+	   between the two positions is reported. */
+	ClipCompressionStats Compress(const ClipCompressionSettings& settings)
+	{
+		ClipCompressionStats stats;
+		std::vector<Bone> original = m_Bones;
+		int maxKeys = 1;
+		for (Bone& bone : m_Bones)
+		{
+			stats.bytesBefore += bone.GetMemoryBytes();
+			stats.keysBefore += bone.GetKeyCount();
+			maxKeys = std::max({ maxKeys, bone.m_NumPositions, bone.m_NumRotations, bone.m_NumScalings });
+			stats.tracks += 3;
+			stats.constantTracks += bone.Compress(settings);
+			stats.bytesAfter += bone.GetMemoryBytes();
+			stats.keysAfter += bone.GetKeyCount();
+		}
+
+		int nodeCount = m_Skeleton.GetNodeCount();
+		std::vector<glm::mat4> originalGlobal(nodeCount), compressedGlobal(nodeCount);
+		std::vector<Bone::Cursor> originalCursors(m_Bones.size()), compressedCursors(m_Bones.size());
+		int samples = 2 * maxKeys;
+		for (int sample = 0; sample <= samples; sample++)
+		{
+			float time = m_Duration * sample / samples;
+			for (int node = 0; node < nodeCount; node++)
+			{
+				glm::mat4 originalLocal = m_Skeleton.transformations[node], compressedLocal = originalLocal;
+				int channel = m_NodeChannels[node];
+				if (channel >= 0)
+				{
+					originalLocal = original[channel].Evaluate(time, originalCursors[channel]);
+					compressedLocal = m_Bones[channel].Evaluate(time, compressedCursors[channel]);
+				}
+				int parent = m_Skeleton.parents[node];
+				originalGlobal[node] = parent < 0 ? originalLocal : originalGlobal[parent] * originalLocal;
+				compressedGlobal[node] = parent < 0 ? compressedLocal : compressedGlobal[parent] * compressedLocal;
+				stats.maxJointError = std::max(stats.maxJointError,
+					glm::length(glm::vec3(originalGlobal[node][3]) - glm::vec3(compressedGlobal[node][3])));
+			}
+		}
+		return stats;
 	}
 
 	~Animation()
@@ -52,60 +121,211 @@ public:
 		else return &(*iter);
 	}
 
+	// channel animating the given skeleton node, resolved at load time
+	inline Bone* GetNodeBone(int nodeIndex)
+	{
+		int channel = m_NodeChannels[nodeIndex];
+		return channel < 0 ? nullptr : &m_Bones[channel];
+	}
+
+	// channel driving the given bone id of the Model, so clips of one model can be paired without names
+	inline Bone* FindBoneByID(int boneID)
+	{
+		if (boneID < 0 || boneID >= (int)m_BoneChannels.size() || m_BoneChannels[boneID] < 0)
+			return nullptr;
+		return &m_Bones[m_BoneChannels[boneID]];
+	}
+
 	
 	inline float GetTicksPerSecond() { return m_TicksPerSecond; }
 	inline float GetDuration() { return m_Duration;}
-	inline const AssimpNodeData& GetRootNode() { return m_RootNode; }
+	inline const Skeleton& GetSkeleton() { return m_Skeleton; }
 	inline const std::map<std::string,BoneInfo>& GetBoneIDMap() 
 	{ 
 		return m_BoneInfoMap;
 	}
+	// bone id/offset of the given skeleton node, id is -1 for non-bone nodes
+	inline const BoneInfo& GetNodeBoneInfo(int nodeIndex) { return m_NodeBoneInfo[nodeIndex]; }
 
 private:
-	void ReadMissingBones(const aiAnimation* animation, Model& model)
-	{
-		int size = animation->mNumChannels;
+	/* Baked layout after the header: duration, ticks per second, the skeleton as
+	   (name, parent, transformation) per node in preorder, then every channel as its
+	   name followed by the position, rotation and scale key arrays. Bone ids are not
+	   stored, they belong to the Model and are looked up again on load. */
+	static constexpr char BAKE_MAGIC[4] = { 'L', 'A', 'N', 'M' };
 
+	// id of the named bone in the Model, registering bones the Model's meshes don't use
+	static int GetOrAddBoneID(const std::string& boneName, Model& model)
+	{
 		auto& boneInfoMap = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
 		int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
 
+		if (boneInfoMap.find(boneName) == boneInfoMap.end())
+		{
+			boneInfoMap[boneName].id = boneCount;
+			boneCount++;
+		}
+		return boneInfoMap[boneName].id;
+	}
+
+	void ReadMissingBones(const aiAnimation* animation, Model& model)
+	{
+		int size = animation->mNumChannels;
+
 		//reading channels(bones engaged in an animation and their keyframes)
 		for (int i = 0; i < size; i++)
 		{
 			auto channel = animation->mChannels[i];
-			std::string boneName = channel->mNodeName.data;
-
-			if (boneInfoMap.find(boneName) == boneInfoMap.end())
-			{
-				boneInfoMap[boneName].id = boneCount;
-				boneCount++;
-			}
 			m_Bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMap[channel->mNodeName.data].id, channel));
+				GetOrAddBoneID(channel->mNodeName.data, model), channel));
+		}
+
+		m_BoneInfoMap = model.GetBoneInfoMap();
+	}
+
+	void SaveBaked(const std::string& animationPath, const std::string& bakePath)
+	{
+		BakeWriter bake;
+		if (!beginBake(bake, BAKE_MAGIC, animationPath))
+			return;
+		bake.write(m_Duration);
+		bake.write(m_TicksPerSecond);
+		bake.write((uint32_t)m_Skeleton.GetNodeCount());
+		for (int node = 0; node < m_Skeleton.GetNodeCount(); node++)
+		{
+			bake.writeString(m_Skeleton.names[node]);
+			bake.write(m_Skeleton.parents[node]);
+			bake.write(m_Skeleton.transformations[node]);
+		}
+		bake.write((uint32_t)m_Bones.size());
+		for (const Bone& bone : m_Bones)
+		{
+			bake.writeString(bone.GetBoneName());
+			bake.writeArray(bone.m_Positions);
+			bake.writeArray(bone.m_Rotations);
+			bake.writeArray(bone.m_Scales);
+		}
+		if (!bake.save(bakePath))
+			std::cout << "ANIMATION::BAKE failed to write " << bakePath << std::endl;
+	}
+
+	// reads the clip from the mapped bake; false if it is missing, stale or damaged
+	bool LoadBaked(const std::string& animationPath, const std::string& bakePath, Model& model)
+	{
+		MappedFile file;
+		if (!openBake(file, bakePath, BAKE_MAGIC, animationPath))
+			return false;
+		BakeReader reader = bakePayload(file);
+
+		float duration = 0.0f;
+		int ticksPerSecond = 0;
+		uint32_t nodeCount = 0;
+		reader.read(duration);
+		reader.read(ticksPerSecond);
+		reader.read(nodeCount);
+		Skeleton skeleton;
+		for (uint32_t node = 0; reader.good() && node < nodeCount; node++)
+		{
+			std::string name;
+			int parent = -1;
+			glm::mat4 transformation;
+			reader.readString(name);
+			reader.read(parent);
+			reader.read(transformation);
+			if (parent >= (int)node)
+				return false;
+			skeleton.names.push_back(std::move(name));
+			skeleton.parents.push_back(parent);
+			skeleton.transformations.push_back(transformation);
+		}
+
+		struct BakedChannel
+		{
+			std::string name;
+			const KeyPosition* positions;
+			const KeyRotation* rotations;
+			const KeyScale* scales;
+			uint32_t numPositions, numRotations, numScales;
+		};
+		uint32_t channelCount = 0;
+		reader.read(channelCount);
+		std::vector<BakedChannel> channels;
+		for (uint32_t i = 0; reader.good() && i < channelCount; i++)
+		{
+			BakedChannel channel;
+			reader.readString(channel.name);
+			channel.positions = reader.readArray<KeyPosition>(channel.numPositions);
+			channel.rotations = reader.readArray<KeyRotation>(channel.numRotations);
+			channel.scales = reader.readArray<KeyScale>(channel.numScales);
+			channels.push_back(std::move(channel));
 		}
+		if (!reader.good())
+			return false;
 
-		m_BoneInfoMap = boneInfoMap;
+		m_Duration = duration;
+		m_TicksPerSecond = ticksPerSecond;
+		m_Skeleton = std::move(skeleton);
+		m_Bones.reserve(channels.size());
+		for (const BakedChannel& channel : channels)
+		{
+			m_Bones.push_back(Bone(channel.name, GetOrAddBoneID(channel.name, model),
+				std::vector<KeyPosition>(channel.positions, channel.positions + channel.numPositions),
+				std::vector<KeyRotation>(channel.rotations, channel.rotations + channel.numRotations),
+				std::vector<KeyScale>(channel.scales, channel.scales + channel.numScales)));
+		}
+		m_BoneInfoMap = model.GetBoneInfoMap();
+		return true;
 	}
 
-	void ReadHierarchyData(AssimpNodeData& dest, const aiNode* src)
+	void ReadHierarchyData(const aiNode* src, int parent)
 	{
 		assert(src);
 
-		dest.name = src->mName.data;
-		dest.transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
-		dest.childrenCount = src->mNumChildren;
+		int index = m_Skeleton.GetNodeCount();
+		m_Skeleton.names.push_back(src->mName.data);
+		m_Skeleton.parents.push_back(parent);
+		m_Skeleton.transformations.push_back(AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation));
+
+		for (unsigned int i = 0; i < src->mNumChildren; i++)
+			ReadHierarchyData(src->mChildren[i], index);
+	}
+
+	void ResolveNodeBindings()
+	{
+		std::unordered_map<std::string, int> channelByName;
+		for (int i = 0; i < (int)m_Bones.size(); i++)
+		{
+			channelByName.emplace(m_Bones[i].GetBoneName(), i);
+			int boneID = m_Bones[i].GetBoneID();
+			if (boneID >= (int)m_BoneChannels.size())
+				m_BoneChannels.resize(boneID + 1, -1);
+			m_BoneChannels[boneID] = i;
+		}
 
-		for (int i = 0; i < src->mNumChildren; i++)
+		BoneInfo noBone;
+		noBone.id = -1;
+		noBone.offset = glm::mat4(1.0f);
+		int nodeCount = m_Skeleton.GetNodeCount();
+		m_NodeChannels.assign(nodeCount, -1);
+		m_NodeBoneInfo.assign(nodeCount, noBone);
+		for (int node = 0; node < nodeCount; node++)
 		{
-			AssimpNodeData newData;
-			ReadHierarchyData(newData, src->mChildren[i]);
-			dest.children.push_back(newData);
+			auto iter = channelByName.find(m_Skeleton.names[node]);
+			if (iter != channelByName.end())
+				m_NodeChannels[node] = iter->second;
+			auto info = m_BoneInfoMap.find(m_Skeleton.names[node]);
+			if (info != m_BoneInfoMap.end())
+				m_NodeBoneInfo[node] = info->second;
 		}
 	}
+
 	float m_Duration;
 	int m_TicksPerSecond;
 	std::vector<Bone> m_Bones;
-	AssimpNodeData m_RootNode;
-	std::map<std::string, BoneInfo> m_BoneInfoMap;
+	std::vector<int> m_NodeChannels;	// node index -> index in m_Bones, -1 if not animated
+	std::vector<int> m_BoneChannels;	// Model bone id -> index in m_Bones, -1 if not animated
+	std::vector<BoneInfo> m_NodeBoneInfo;	// node index -> final matrix slot and offset
+	Skeleton m_Skeleton;
+	std::map<std::string, BoneInfo> m_BoneInfoMap;	// copied from the Model at load, outlives it
 };
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <learnopengl/animation.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/job_system.h>
+
+/* A crowd of characters animated together. Every character is an Animator; an update
+   evaluates all of them in parallel on a JobSystem, a chunk of characters per job, and
+   writes their bone matrices into one contiguous palette, MAX_BONES per character.
+   That is the layout SkinningPalette::UploadCharacters takes, so the whole crowd goes
+   to the GPU in one upload.
+
+   Like Animator, the palette is double buffered: UpdatePose() fills the back one while
+   the front one returned by GetPalettes() may still be read, PublishPose() swaps them. */
+class AnimationWorld
+{
+public:
+  static const int MAX_BONES = 100;
+
+  // characters per job; a few keep the per job overhead small without starving threads
+  int chunkSize = 8;
+
+  AnimationWorld(JobSystem &jobs) : m_Jobs(jobs)
+  {
+  }
+
+  // adds a character playing animation from startTime (in ticks) and returns its index
+  int AddCharacter(Animation *animation, float startTime = 0.0f)
+  {
+    m_Animators.emplace_back(animation);
+    m_Animators.back().PlayAnimation(animation, NULL, startTime, 0.0f, 0.0f);
+    for (std::vector<glm::mat4> &palette : m_Palettes)
+      palette.resize(m_Animators.size() * MAX_BONES, glm::mat4(1.0f));
+    return (int)m_Animators.size() - 1;
+  }
+
+  // e.g. to PlayAnimation on it; the reference is invalidated by AddCharacter
+  Animator &GetAnimator(int character) { return m_Animators[character]; }
+  int GetCharacterCount() const { return (int)m_Animators.size(); }
+
+  void UpdateAnimation(float dt)
+  {
+    UpdatePose(dt);
+    PublishPose();
+  }
+
+  // advances every character and evaluates its pose into the back palette
+  void UpdatePose(float dt)
+  {
+    glm::mat4 *palettes = m_Palettes[1 - m_FrontBuffer].data();
+    m_Jobs.ParallelFor(GetCharacterCount(), chunkSize, [&](int begin, int end)
+    {
+      for (int character = begin; character < end; character++)
+        m_Animators[character].UpdatePose(dt, palettes + character * MAX_BONES, MAX_BONES);
+    });
+  }
+
+  void PublishPose()
+  {
+    m_FrontBuffer = 1 - m_FrontBuffer;
+  }
+
+  // GetCharacterCount() * MAX_BONES matrices of the last published poses
+  const glm::mat4 *GetPalettes() const { return m_Palettes[m_FrontBuffer].data(); }
+  const glm::mat4 *GetPalette(int character) const { return GetPalettes() + character * MAX_BONES; }
+
+private:
+  JobSystem &m_Jobs;
+  std::vector<Animator> m_Animators;
+  std::vector<glm::mat4> m_Palettes[2]; // front (read) and back (written)
+  int m_FrontBuffer = 0;
+};
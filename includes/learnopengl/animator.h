@@ -6,7 +6,9 @@
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
 #include <learnopengl/animation.h>
+#include <learnopengl/blend_tree.h>
 #include <learnopengl/bone.h>
+#include <learnopengl/pose_kernel.h>
 
 class Animator
 {
@@ -18,15 +20,38 @@ public:
     m_CurrentAnimation2 = NULL;
     m_blendAmount = 0;
 
-    m_FinalBoneMatrices.reserve(100);
-
-    for (int i = 0; i < 100; i++)
-      m_FinalBoneMatrices.push_back(glm::mat4(1.0f));
+    m_FinalBoneMatrices[0].assign(100, glm::mat4(1.0f));
+    m_FinalBoneMatrices[1].assign(100, glm::mat4(1.0f));
   }
 
+  // advances and evaluates the pose, then publishes it to GetFinalBoneMatrices()
   void UpdateAnimation(float dt)
+  {
+    UpdatePose(dt);
+    PublishPose();
+  }
+
+  /* Advances and evaluates the pose into the back buffer without touching the
+     matrices returned by GetFinalBoneMatrices(), so another thread may read frame N
+     while this one computes frame N + 1. Call PublishPose() once both are done. */
+  void UpdatePose(float dt)
+  {
+    std::vector<glm::mat4> &finalBoneMatrices = m_FinalBoneMatrices[1 - m_FrontBuffer];
+    UpdatePose(dt, finalBoneMatrices.data(), (int)finalBoneMatrices.size());
+  }
+
+  /* Same, but writes the bone matrices to palette[0, count) instead, e.g. this
+     character's slot in an AnimationWorld. Only reads the Animation, so animators
+     sharing clips can be updated on different threads. */
+  void UpdatePose(float dt, glm::mat4 *palette, int count)
   {
     m_DeltaTime = dt;
+    if (m_BlendTree)
+    {
+      m_BlendTree->Update(dt);
+      m_BlendTree->Evaluate(palette, count);
+      return;
+    }
     if (m_CurrentAnimation)
     {
       m_CurrentTime += m_CurrentAnimation->GetTicksPerSecond() * dt;
@@ -38,12 +63,13 @@ public:
         m_CurrentTime2 = fmod(m_CurrentTime2, m_CurrentAnimation2->GetDuration());
       }
 
-      CalculateBoneTransform(&m_CurrentAnimation->GetRootNode(), glm::mat4(1.0f));
+      CalculateBoneTransform(palette, count);
     }
   }
 
   void PlayAnimation(Animation *pAnimation, Animation *pAnimation2, float time1, float time2, float blend)
   {
+    m_BlendTree = NULL;
     m_CurrentAnimation = pAnimation;
     m_CurrentTime = time1;
     m_CurrentAnimation2 = pAnimation2;
@@ -51,18 +77,21 @@ public:
     m_blendAmount = blend;
   }
 
-  glm::mat4 UpdateBlend(Bone *Bone1, Bone *Bone2)
+  /* Poses the character with tree from now on, which holds its own clips and
+     weights; PlayAnimation goes back to playing clips directly. */
+  void PlayBlendTree(BlendTree *tree)
+  {
+    m_BlendTree = tree;
+  }
+
+  glm::mat4 UpdateBlend(const Bone *Bone1, const Bone *Bone2, Bone::Cursor &cursor1, Bone::Cursor &cursor2)
   {
     glm::vec3 bonePos1, bonePos2, finalPos;
     glm::vec3 boneScale1, boneScale2, finalScale;
     glm::quat boneRot1, boneRot2, finalRot;
 
-    Bone1->InterpolatePosition(m_CurrentTime, bonePos1);
-    Bone2->InterpolatePosition(m_CurrentTime2, bonePos2);
-    Bone1->InterpolateRotation(m_CurrentTime, boneRot1);
-    Bone2->InterpolateRotation(m_CurrentTime2, boneRot2);
-    Bone1->InterpolateScaling(m_CurrentTime, boneScale1);
-    Bone2->InterpolateScaling(m_CurrentTime2, boneScale2);
+    Bone1->Sample(m_CurrentTime, cursor1, bonePos1, boneRot1, boneScale1);
+    Bone2->Sample(m_CurrentTime2, cursor2, bonePos2, boneRot2, boneScale2);
 
     finalPos = glm::mix(bonePos1, bonePos2, m_blendAmount);
     finalRot = glm::slerp(boneRot1, boneRot2, m_blendAmount);
@@ -78,50 +107,157 @@ public:
     return TRS;
   }
 
-  void CalculateBoneTransform(const AssimpNodeData *node, glm::mat4 parentTransform)
+  void CalculateBoneTransform()
   {
-    std::string nodeName = node->name;
-    glm::mat4 nodeTransform = node->transformation;
+    std::vector<glm::mat4> &finalBoneMatrices = m_FinalBoneMatrices[1 - m_FrontBuffer];
+    CalculateBoneTransform(finalBoneMatrices.data(), (int)finalBoneMatrices.size());
+  }
 
-    Bone *Bone1 = m_CurrentAnimation->FindBone(nodeName);
-    Bone *Bone2 = NULL;
-    if (m_CurrentAnimation2)
+  // evaluate poses with the structure of arrays kernel of pose_kernel.h; false takes the
+  // per bone glm path below, which the kernel is checked against
+  static inline bool s_UsePoseKernel = true;
+
+  // evaluates the pose in one pass over the flattened skeleton; parents precede children
+  void CalculateBoneTransform(glm::mat4 *finalBoneMatrices, int count)
+  {
+    if (s_UsePoseKernel)
     {
-      Bone2 = m_CurrentAnimation2->FindBone(nodeName);
+      CalculateBoneTransformSoA(finalBoneMatrices, count);
+      return;
     }
 
-    if (Bone1)
+    const Skeleton &skeleton = m_CurrentAnimation->GetSkeleton();
+    int nodeCount = skeleton.GetNodeCount();
+    m_GlobalTransforms.resize(nodeCount);
+    m_Cursors.resize(nodeCount);
+    m_Cursors2.resize(nodeCount);
+
+    for (int node = 0; node < nodeCount; node++)
     {
-      Bone1->Update(m_CurrentTime);
-      nodeTransform = Bone1->GetLocalTransform();
+      glm::mat4 nodeTransform = skeleton.transformations[node];
+
+      const Bone *Bone1 = m_CurrentAnimation->GetNodeBone(node);
+      const Bone *Bone2 = NULL;
+      if (m_CurrentAnimation2 && Bone1)
+      {
+        Bone2 = m_CurrentAnimation2->FindBoneByID(Bone1->GetBoneID());
+      }
 
-      if (Bone2)
+      if (Bone1)
       {
-        nodeTransform = UpdateBlend(Bone1, Bone2);
+        if (Bone2)
+          nodeTransform = UpdateBlend(Bone1, Bone2, m_Cursors[node], m_Cursors2[node]);
+        else
+          nodeTransform = Bone1->Evaluate(m_CurrentTime, m_Cursors[node]);
       }
+
+      int parent = skeleton.parents[node];
+      m_GlobalTransforms[node] = parent < 0 ? nodeTransform : m_GlobalTransforms[parent] * nodeTransform;
+
+      const BoneInfo &boneInfo = m_CurrentAnimation->GetNodeBoneInfo(node);
+      if (boneInfo.id >= 0 && boneInfo.id < count)
+        finalBoneMatrices[boneInfo.id] = m_GlobalTransforms[node] * boneInfo.offset;
     }
+  }
+
+  /* The same pose, with the key interpolation, blending and TRS composition of all
+     animated nodes done together by the pose kernel. Only the key search and the
+     walk down the hierarchy remain per node. */
+  void CalculateBoneTransformSoA(glm::mat4 *finalBoneMatrices, int count)
+  {
+    const Skeleton &skeleton = m_CurrentAnimation->GetSkeleton();
+    int nodeCount = skeleton.GetNodeCount();
+    m_LocalTransforms.resize(nodeCount);
+    m_GlobalTransforms.resize(nodeCount);
+    m_Cursors.resize(nodeCount);
+    m_Cursors2.resize(nodeCount);
 
-    glm::mat4 globalTransformation = parentTransform * nodeTransform;
+    // the animated nodes in skeleton order, one kernel slot each
+    m_AnimatedNodes.clear();
+    for (int node = 0; node < nodeCount; node++)
+      if (m_CurrentAnimation->GetNodeBone(node))
+        m_AnimatedNodes.push_back(node);
+    int animatedCount = (int)m_AnimatedNodes.size();
+    m_KeysFrom.Resize(animatedCount);
+    m_KeysTo.Resize(animatedCount);
+    m_Pose.Resize(animatedCount);
+    m_KeyWeights.Resize(m_Pose);
 
-    auto boneInfoMap = m_CurrentAnimation->GetBoneIDMap();
-    if (boneInfoMap.find(nodeName) != boneInfoMap.end())
+    for (int slot = 0; slot < animatedCount; slot++)
     {
-      int index = boneInfoMap[nodeName].id;
-      glm::mat4 offset = boneInfoMap[nodeName].offset;
-      m_FinalBoneMatrices[index] = globalTransformation * offset;
+      int node = m_AnimatedNodes[slot];
+      m_CurrentAnimation->GetNodeBone(node)->GatherKeys(m_CurrentTime, m_Cursors[node], m_KeysFrom, m_KeysTo, m_KeyWeights, slot);
     }
+    InterpolatePoses(m_KeysFrom, m_KeysTo, m_KeyWeights, m_Pose);
 
-    for (int i = 0; i < node->childrenCount; i++)
-      CalculateBoneTransform(&node->children[i], globalTransformation);
+    if (m_CurrentAnimation2)
+    {
+      // the second clip where it animates the same bone, blended over the first
+      m_BlendWeights.Resize(m_Pose);
+      for (int slot = 0; slot < animatedCount; slot++)
+      {
+        int node = m_AnimatedNodes[slot];
+        const Bone *Bone2 = m_CurrentAnimation2->FindBoneByID(m_CurrentAnimation->GetNodeBone(node)->GetBoneID());
+        if (Bone2)
+        {
+          Bone2->GatherKeys(m_CurrentTime2, m_Cursors2[node], m_KeysFrom, m_KeysTo, m_KeyWeights, slot);
+          m_BlendWeights.Set(slot, m_blendAmount);
+        }
+        else
+        {
+          m_KeysFrom.Set(slot, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+          m_KeysTo.Set(slot, glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+        }
+      }
+      InterpolatePoses(m_KeysFrom, m_KeysTo, m_KeyWeights, m_KeysFrom);
+      InterpolatePoses(m_Pose, m_KeysFrom, m_BlendWeights, m_Pose);
+    }
+    m_AnimatedTransforms.resize(animatedCount);
+    ComposeMatrices(m_Pose, m_AnimatedTransforms.data());
+
+    int slot = 0;
+    for (int node = 0; node < nodeCount; node++)
+    {
+      bool animated = slot < animatedCount && m_AnimatedNodes[slot] == node;
+      m_LocalTransforms[node] = animated ? m_AnimatedTransforms[slot++] : skeleton.transformations[node];
+
+      int parent = skeleton.parents[node];
+      if (parent < 0)
+        m_GlobalTransforms[node] = m_LocalTransforms[node];
+      else
+        MultiplyMatrices(m_GlobalTransforms[parent], m_LocalTransforms[node], m_GlobalTransforms[node]);
+
+      const BoneInfo &boneInfo = m_CurrentAnimation->GetNodeBoneInfo(node);
+      if (boneInfo.id >= 0 && boneInfo.id < count)
+        MultiplyMatrices(m_GlobalTransforms[node], boneInfo.offset, finalBoneMatrices[boneInfo.id]);
+    }
+  }
+
+  // swaps the back buffer written by UpdatePose() with the one being read
+  void PublishPose()
+  {
+    m_FrontBuffer = 1 - m_FrontBuffer;
   }
 
-  std::vector<glm::mat4> GetFinalBoneMatrices()
+  // matrices of the last published pose; valid until the next PublishPose()
+  const std::vector<glm::mat4> &GetFinalBoneMatrices() const
   {
-    return m_FinalBoneMatrices;
+    return m_FinalBoneMatrices[m_FrontBuffer];
   }
 
   // private:
-  std::vector<glm::mat4> m_FinalBoneMatrices;
+  std::vector<glm::mat4> m_FinalBoneMatrices[2]; // front (read) and back (written) pose
+  int m_FrontBuffer = 0;
+  std::vector<glm::mat4> m_LocalTransforms;  // per skeleton node, parallel to Skeleton::parents
+  std::vector<glm::mat4> m_GlobalTransforms;
+  std::vector<Bone::Cursor> m_Cursors;  // per skeleton node, key search state in the first clip
+  std::vector<Bone::Cursor> m_Cursors2; // and in the second one
+  // scratch of CalculateBoneTransformSoA, kept to reuse the memory
+  std::vector<int> m_AnimatedNodes;
+  PoseSoA m_KeysFrom, m_KeysTo, m_Pose;
+  PoseWeights m_KeyWeights, m_BlendWeights;
+  std::vector<glm::mat4> m_AnimatedTransforms;
+  BlendTree *m_BlendTree = NULL;
   Animation *m_CurrentAnimation;
   Animation *m_CurrentAnimation2;
   float m_CurrentTime;
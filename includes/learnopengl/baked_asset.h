@@ -0,0 +1,305 @@
+#ifndef BAKED_ASSET_H
+#define BAKED_ASSET_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Baked assets are flat binary snapshots of what Model/Animation build from an Assimp scene,
+// written next to the source file on first load and mapped into memory on later loads.
+//
+// layout: BakeHeader, then the payload written by the asset. Arrays are stored as a uint32
+// count followed by the raw elements, padded so every array starts on BAKE_ALIGNMENT bytes.
+// A bake is stale when its version or magic don't match, or when the source file changed:
+// same size and mtime means unchanged, otherwise the source content hash decides.
+
+const uint32_t BAKE_VERSION = 3;
+const size_t BAKE_ALIGNMENT = 16;
+
+struct BakeHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t sourceHash;
+};
+
+// size, modification time and FNV-1a content hash of a source file
+struct SourceStamp
+{
+    uint64_t size = 0;
+    int64_t time = 0;
+    uint64_t hash = 0;
+
+    bool read(const std::string &path, bool withHash)
+    {
+        std::error_code error;
+        size = std::filesystem::file_size(path, error);
+        if (error)
+            return false;
+        time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        if (error)
+            return false;
+        if (!withHash)
+            return true;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        hash = 14695981039346656037ull;
+        char buffer[1 << 16];
+        while (file)
+        {
+            file.read(buffer, sizeof(buffer));
+            for (std::streamsize i = 0; i < file.gcount(); i++)
+            {
+                hash ^= (unsigned char)buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return true;
+    }
+};
+
+// read-only view of a whole file; mmap where available, a plain read otherwise
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(const std::string &path)
+    {
+        close();
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = reinterpret_cast<const unsigned char *>(buffer.data());
+        length = buffer.size();
+        return length > 0;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+        bytes = static_cast<const unsigned char *>(mapping);
+        length = (size_t)info.st_size;
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        std::vector<char>().swap(buffer);
+#else
+        if (bytes)
+            munmap(const_cast<unsigned char *>(bytes), length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+};
+
+// bounds-checked cursor over a baked file; every read fails once the data runs out
+class BakeReader
+{
+public:
+    BakeReader(const unsigned char *data, size_t size) : data(data), size(size) {}
+
+    template <typename T>
+    bool read(T &value)
+    {
+        if (!ok || offset + sizeof(T) > size)
+            return fail();
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    // points straight into the file, valid as long as the file stays open
+    template <typename T>
+    const T *readArray(uint32_t &count)
+    {
+        if (!read(count))
+            return nullptr;
+        align();
+        if (!ok || offset + (size_t)count * sizeof(T) > size)
+        {
+            fail();
+            return nullptr;
+        }
+        const T *values = reinterpret_cast<const T *>(data + offset);
+        offset += (size_t)count * sizeof(T);
+        return values;
+    }
+
+    bool readString(std::string &value)
+    {
+        uint32_t count = 0;
+        const char *chars = readArray<char>(count);
+        if (!ok)
+            return false;
+        value.assign(chars, count);
+        return true;
+    }
+
+    bool good() const { return ok; }
+
+    // bytes left to read, to bound counts before allocating for them
+    size_t remaining() const { return ok ? size - offset : 0; }
+
+private:
+    const unsigned char *data;
+    size_t size;
+    size_t offset = 0;
+    bool ok = true;
+
+    void align()
+    {
+        offset = (offset + BAKE_ALIGNMENT - 1) / BAKE_ALIGNMENT * BAKE_ALIGNMENT;
+    }
+
+    bool fail()
+    {
+        ok = false;
+        return false;
+    }
+};
+
+// collects a baked file in memory and writes it in one go
+class BakeWriter
+{
+public:
+    template <typename T>
+    void write(const T &value)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const T *values, uint32_t count)
+    {
+        write(count);
+        buffer.resize((buffer.size() + BAKE_ALIGNMENT - 1) / BAKE_ALIGNMENT * BAKE_ALIGNMENT, 0);
+        const char *bytes = reinterpret_cast<const char *>(values);
+        buffer.insert(buffer.end(), bytes, bytes + (size_t)count * sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const std::vector<T> &values)
+    {
+        writeArray(values.data(), (uint32_t)values.size());
+    }
+
+    void writeString(const std::string &value)
+    {
+        writeArray(value.data(), (uint32_t)value.size());
+    }
+
+    void clear()
+    {
+        std::vector<char>().swap(buffer);
+    }
+
+    // writes to a temporary file first so a crash never leaves a half-written bake behind
+    bool save(const std::string &path) const
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(buffer.data(), buffer.size()))
+                return false;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+private:
+    std::vector<char> buffer;
+};
+
+// starts a bake for sourcePath; returns false when the source can't be stamped
+inline bool beginBake(BakeWriter &writer, const char magic[4], const std::string &sourcePath)
+{
+    SourceStamp stamp;
+    if (!stamp.read(sourcePath, true))
+        return false;
+    BakeHeader header;
+    std::memcpy(header.magic, magic, 4);
+    header.version = BAKE_VERSION;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    writer.write(header);
+    return true;
+}
+
+// maps bakePath and checks it is an up to date bake of sourcePath; the reader is then
+// positioned right after the header
+inline bool openBake(MappedFile &file, const std::string &bakePath, const char magic[4], const std::string &sourcePath)
+{
+    if (!file.open(bakePath))
+        return false;
+    BakeReader reader(file.data(), file.size());
+    BakeHeader header;
+    SourceStamp stamp;
+    bool fresh = reader.read(header) && std::memcmp(header.magic, magic, 4) == 0 &&
+                 header.version == BAKE_VERSION && stamp.read(sourcePath, false) &&
+                 header.sourceSize == stamp.size &&
+                 (header.sourceTime == stamp.time || (stamp.read(sourcePath, true) && header.sourceHash == stamp.hash));
+    if (!fresh)
+        file.close();
+    return fresh;
+}
+
+inline BakeReader bakePayload(const MappedFile &file)
+{
+    BakeReader reader(file.data(), file.size());
+    BakeHeader header;
+    reader.read(header);
+    return reader;
+}
+#endif
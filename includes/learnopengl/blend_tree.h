@@ -0,0 +1,398 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <learnopengl/animation.h>
+#include <learnopengl/bone.h>
+#include <learnopengl/pose_kernel.h>
+
+/* Layered blending of any number of clips of one skeleton.
+
+   A tree is a stack of layers, each holding weighted clips. The clips of a layer are
+   blended by their weights (normalized, so they only need to be relative); layer 0 is
+   the base pose and every further layer goes on top of the layers below it, either
+   replacing their pose (BLEND_OVERRIDE) or adding its difference to a reference pose
+   (BLEND_ADDITIVE, e.g. breathing or leaning over any locomotion). A layer weight
+   fades the whole layer, a mask of per node weights limits it to part of the body.
+
+   Weights change immediately with SetWeight or over time with CrossFade/FadeLayer,
+   which take seconds, so transitions don't depend on the frame rate.
+
+   Every clip with a weight is sampled once per Evaluate into a pose buffer of the
+   structure of arrays kernel (pose_kernel.h), and the poses are blended as a whole.
+   All buffers are sized when clips and layers are added; Update and Evaluate
+   allocate nothing. A tree holds the playback state of one character, the clips it
+   plays may be shared. */
+
+enum BlendLayerMode
+{
+  BLEND_OVERRIDE,
+  BLEND_ADDITIVE,
+};
+
+class BlendTree
+{
+public:
+  /* skeleton: a clip whose node hierarchy and bone ids the tree poses, usually one of
+     the clips added later. Layer 0, the base layer, exists from the start. */
+  explicit BlendTree(Animation *skeleton) : m_Skeleton(skeleton)
+  {
+    const Skeleton &nodes = skeleton->GetSkeleton();
+    int nodeCount = nodes.GetNodeCount();
+    m_BindPose.Resize(nodeCount);
+    for (int node = 0; node < nodeCount; node++)
+    {
+      // translation * rotation * scale, as the clips' keys are; shear is dropped
+      const glm::mat4 &transform = nodes.transformations[node];
+      glm::vec3 scale(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                      glm::length(glm::vec3(transform[2])));
+      glm::mat3 rotation(glm::vec3(transform[0]) / scale.x, glm::vec3(transform[1]) / scale.y,
+                         glm::vec3(transform[2]) / scale.z);
+      m_BindPose.Set(node, glm::vec3(transform[3]), glm::normalize(glm::quat_cast(rotation)), scale);
+    }
+    m_Pose = m_BindPose;
+    m_LayerPose = m_BindPose;
+    m_ClipPose = m_BindPose;
+    m_KeysFrom = m_BindPose;
+    m_KeysTo = m_BindPose;
+    m_KeyWeights.Resize(m_Pose);
+    m_BlendWeights.Resize(m_Pose);
+    m_LocalTransforms.resize(nodeCount);
+    m_GlobalTransforms.resize(nodeCount);
+    AddLayer(BLEND_OVERRIDE);
+  }
+
+  // adds a layer on top of the others and returns its index
+  int AddLayer(BlendLayerMode mode, float weight = 1.0f)
+  {
+    m_Layers.emplace_back();
+    Layer &layer = m_Layers.back();
+    layer.mode = mode;
+    layer.weight.Set(weight);
+    if (mode == BLEND_ADDITIVE)
+      layer.reference = m_BindPose;
+    return (int)m_Layers.size() - 1;
+  }
+
+  /* Adds animation to layer and returns the clip's index. Clips play at speed times
+     their own tick rate, looped or holding their last frame. The first clip of an
+     additive layer also becomes its reference pose at time 0, see SetReferencePose. */
+  int AddClip(int layer, Animation *animation, float weight = 0.0f, bool loop = true, float speed = 1.0f)
+  {
+    m_Clips.emplace_back();
+    Clip &clip = m_Clips.back();
+    clip.animation = animation;
+    clip.layer = layer;
+    clip.loop = loop;
+    clip.speed = speed;
+    clip.weight.Set(weight);
+    BindClip(clip);
+
+    Layer &owner = m_Layers[layer];
+    owner.clips.push_back((int)m_Clips.size() - 1);
+    if (owner.mode == BLEND_ADDITIVE && owner.clips.size() == 1)
+      SetReferencePose(layer, animation, 0.0f);
+    return (int)m_Clips.size() - 1;
+  }
+
+  // the pose an additive layer's clips are taken relative to: animation at time (in ticks)
+  void SetReferencePose(int layer, Animation *animation, float time)
+  {
+    Clip reference;
+    reference.animation = animation;
+    reference.time = time;
+    BindClip(reference);
+    SampleClip(reference, m_Layers[layer].reference);
+  }
+
+  // sets a clip's weight at once, stopping a fade it was in
+  void SetWeight(int clip, float weight)
+  {
+    m_Clips[clip].weight.Set(weight);
+  }
+
+  /* Fades clip in to weight 1 and the other clips of its layer out to 0 over seconds,
+     with a smoothstep ease. A clip that wasn't playing starts from its first frame. */
+  void CrossFade(int clip, float seconds)
+  {
+    Clip &target = m_Clips[clip];
+    if (target.weight.value <= 0.0f)
+      SetTime(clip, 0.0f);
+    for (int other : m_Layers[target.layer].clips)
+      m_Clips[other].weight.Start(other == clip ? 1.0f : 0.0f, seconds);
+  }
+
+  // fades the weight of a whole layer to weight over seconds
+  void FadeLayer(int layer, float weight, float seconds)
+  {
+    m_Layers[layer].weight.Start(weight, seconds);
+  }
+
+  /* Limits layer to the subtree of nodeName with weight, leaving the rest of the
+     skeleton to the layers below. Further calls add subtrees with their own weight,
+     later ones overriding earlier ones where they overlap. False if no node has the
+     name. */
+  bool SetMask(int layer, const std::string &nodeName, float weight = 1.0f)
+  {
+    const Skeleton &nodes = m_Skeleton->GetSkeleton();
+    int root = (int)(std::find(nodes.names.begin(), nodes.names.end(), nodeName) - nodes.names.begin());
+    if (root == nodes.GetNodeCount())
+      return false;
+
+    std::vector<float> &mask = m_Layers[layer].mask;
+    if (mask.empty())
+      mask.assign(nodes.GetNodeCount(), 0.0f);
+    // preorder: the subtree is the nodes after root whose parent is in it
+    std::vector<bool> inSubtree(nodes.GetNodeCount(), false);
+    inSubtree[root] = true;
+    mask[root] = weight;
+    for (int node = root + 1; node < nodes.GetNodeCount(); node++)
+    {
+      int parent = nodes.parents[node];
+      if (parent >= 0 && inSubtree[parent])
+      {
+        inSubtree[node] = true;
+        mask[node] = weight;
+      }
+    }
+    return true;
+  }
+
+  // lets layer affect the whole skeleton again
+  void ClearMask(int layer)
+  {
+    m_Layers[layer].mask.clear();
+  }
+
+  float GetWeight(int clip) const { return m_Clips[clip].weight.value; }
+  float GetLayerWeight(int layer) const { return m_Layers[layer].weight.value; }
+  bool IsFading(int clip) const { return m_Clips[clip].weight.IsFading(); }
+
+  // playback position in ticks, and as a fraction of the clip's duration
+  float GetTime(int clip) const { return m_Clips[clip].time; }
+  float GetNormalizedTime(int clip) const { return m_Clips[clip].time / m_Clips[clip].animation->GetDuration(); }
+  void SetTime(int clip, float time) { m_Clips[clip].time = time; }
+
+  // advances fades and the clips that have a weight by dt seconds
+  void Update(float dt)
+  {
+    for (Layer &layer : m_Layers)
+      layer.weight.Advance(dt);
+    for (Clip &clip : m_Clips)
+    {
+      clip.weight.Advance(dt);
+      if (clip.weight.value <= 0.0f)
+        continue;
+      float duration = clip.animation->GetDuration();
+      clip.time += clip.animation->GetTicksPerSecond() * clip.speed * dt;
+      if (clip.loop)
+      {
+        clip.time = std::fmod(clip.time, duration);
+        if (clip.time < 0.0f)
+          clip.time += duration;
+      }
+      else
+      {
+        clip.time = glm::clamp(clip.time, 0.0f, duration);
+      }
+    }
+  }
+
+  // blends the current pose and writes the bone matrices to palette[0, count)
+  void Evaluate(glm::mat4 *palette, int count)
+  {
+    m_Pose = m_BindPose;
+    for (Layer &layer : m_Layers)
+    {
+      float layerWeight = layer.weight.value;
+      if (layerWeight <= 0.0f)
+        continue;
+      // a full, unmasked override needs no blend with what is below it
+      if (layer.mode == BLEND_OVERRIDE && layerWeight >= 1.0f && layer.mask.empty())
+      {
+        BlendClips(layer, m_Pose);
+        continue;
+      }
+      if (!BlendClips(layer, m_LayerPose))
+        continue;
+
+      if (layer.mask.empty())
+      {
+        m_BlendWeights.Fill(layerWeight);
+      }
+      else
+      {
+        for (int node = 0; node < (int)layer.mask.size(); node++)
+          m_BlendWeights.Set(node, layerWeight * layer.mask[node]);
+      }
+      if (layer.mode == BLEND_ADDITIVE)
+      {
+        SubtractPoses(m_LayerPose, layer.reference, m_LayerPose);
+        AddPoses(m_Pose, m_LayerPose, m_BlendWeights, m_Pose);
+      }
+      else
+      {
+        InterpolatePoses(m_Pose, m_LayerPose, m_BlendWeights, m_Pose);
+      }
+    }
+
+    ComposeMatrices(m_Pose, m_LocalTransforms.data());
+    const Skeleton &skeleton = m_Skeleton->GetSkeleton();
+    for (int node = 0; node < skeleton.GetNodeCount(); node++)
+    {
+      int parent = skeleton.parents[node];
+      if (parent < 0)
+        m_GlobalTransforms[node] = m_LocalTransforms[node];
+      else
+        MultiplyMatrices(m_GlobalTransforms[parent], m_LocalTransforms[node], m_GlobalTransforms[node]);
+
+      const BoneInfo &boneInfo = m_Skeleton->GetNodeBoneInfo(node);
+      if (boneInfo.id >= 0 && boneInfo.id < count)
+        MultiplyMatrices(m_GlobalTransforms[node], boneInfo.offset, palette[boneInfo.id]);
+    }
+  }
+
+private:
+  // a weight that is either set or fading from one value to another over time
+  struct Fade
+  {
+    float value = 0.0f;
+    float from = 0.0f;
+    float to = 0.0f;
+    float elapsed = 0.0f;
+    float duration = 0.0f;
+
+    void Set(float weight)
+    {
+      value = from = to = weight;
+      elapsed = duration = 0.0f;
+    }
+
+    void Start(float target, float seconds)
+    {
+      if (seconds <= 0.0f)
+      {
+        Set(target);
+        return;
+      }
+      from = value;
+      to = target;
+      elapsed = 0.0f;
+      duration = seconds;
+    }
+
+    void Advance(float dt)
+    {
+      if (!IsFading())
+        return;
+      elapsed = std::min(elapsed + dt, duration);
+      float t = elapsed / duration;
+      value = glm::mix(from, to, t * t * (3.0f - 2.0f * t));
+      if (elapsed >= duration)
+        Set(to);
+    }
+
+    bool IsFading() const { return duration > 0.0f; }
+  };
+
+  struct Clip
+  {
+    Animation *animation = nullptr;
+    int layer = 0;
+    float time = 0.0f; // in ticks
+    float speed = 1.0f;
+    bool loop = true;
+    Fade weight;
+    std::vector<const Bone *> bones;  // per skeleton node, the channel animating it or null
+    std::vector<Bone::Cursor> cursors; // per skeleton node
+  };
+
+  struct Layer
+  {
+    BlendLayerMode mode = BLEND_OVERRIDE;
+    Fade weight;
+    std::vector<int> clips;
+    std::vector<float> mask; // per skeleton node; empty for the whole skeleton
+    PoseSoA reference;       // additive layers only
+  };
+
+  Animation *m_Skeleton;
+  std::vector<Clip> m_Clips;
+  std::vector<Layer> m_Layers;
+
+  // pose buffers shared by all clips and layers, per skeleton node
+  PoseSoA m_BindPose;
+  PoseSoA m_Pose;      // the blended result
+  PoseSoA m_LayerPose; // the clips of one layer blended
+  PoseSoA m_ClipPose;  // one clip sampled
+  PoseSoA m_KeysFrom, m_KeysTo;
+  PoseWeights m_KeyWeights, m_BlendWeights;
+  std::vector<glm::mat4> m_LocalTransforms;
+  std::vector<glm::mat4> m_GlobalTransforms;
+
+  // pairs the clip's channels with the skeleton's nodes through the Model's bone ids
+  void BindClip(Clip &clip)
+  {
+    int nodeCount = m_Skeleton->GetSkeleton().GetNodeCount();
+    clip.bones.assign(nodeCount, nullptr);
+    clip.cursors.assign(nodeCount, Bone::Cursor());
+    for (int node = 0; node < nodeCount; node++)
+    {
+      if (clip.animation == m_Skeleton)
+        clip.bones[node] = m_Skeleton->GetNodeBone(node);
+      else if (m_Skeleton->GetNodeBoneInfo(node).id >= 0)
+        clip.bones[node] = clip.animation->FindBoneByID(m_Skeleton->GetNodeBoneInfo(node).id);
+    }
+  }
+
+  // out = the clip at its time; nodes it doesn't animate keep the bind pose
+  void SampleClip(Clip &clip, PoseSoA &out)
+  {
+    glm::vec3 translation, scale;
+    glm::quat rotation;
+    for (int node = 0; node < (int)clip.bones.size(); node++)
+    {
+      if (clip.bones[node])
+      {
+        clip.bones[node]->GatherKeys(clip.time, clip.cursors[node], m_KeysFrom, m_KeysTo, m_KeyWeights, node);
+        continue;
+      }
+      m_BindPose.Get(node, translation, rotation, scale);
+      m_KeysFrom.Set(node, translation, rotation, scale);
+      m_KeysTo.Set(node, translation, rotation, scale);
+      m_KeyWeights.Set(node, 0.0f);
+    }
+    InterpolatePoses(m_KeysFrom, m_KeysTo, m_KeyWeights, out);
+  }
+
+  /* out = the weighted average of the layer's clips, accumulated one clip at a time:
+     each is mixed in by its share of the weight seen so far. False, leaving out
+     alone, if no clip has a weight. */
+  bool BlendClips(Layer &layer, PoseSoA &out)
+  {
+    float total = 0.0f;
+    for (int index : layer.clips)
+    {
+      Clip &clip = m_Clips[index];
+      float weight = clip.weight.value;
+      if (weight <= 0.0f)
+        continue;
+      if (total == 0.0f)
+      {
+        SampleClip(clip, out);
+      }
+      else
+      {
+        SampleClip(clip, m_ClipPose);
+        m_BlendWeights.Fill(weight / (total + weight));
+        InterpolatePoses(out, m_ClipPose, m_BlendWeights, out);
+      }
+      total += weight;
+    }
+    return total > 0.0f;
+  }
+};
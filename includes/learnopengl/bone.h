@@ -3,12 +3,15 @@
 /* Container for bone data */
 
 #include <vector>
+#include <algorithm>
 #include <assimp/scene.h>
 #include <list>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 #include <learnopengl/assimp_glm_helpers.h>
+#include <learnopengl/clip_compression.h>
+#include <learnopengl/pose_kernel.h>
 
 struct KeyPosition
 {
@@ -71,6 +74,128 @@ public:
     }
   }
 
+  // takes already converted key tracks, e.g. read back from a baked Animation
+  Bone(const std::string &name, int ID, std::vector<KeyPosition> positions,
+       std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
+      : m_Positions(std::move(positions)),
+        m_Rotations(std::move(rotations)),
+        m_Scales(std::move(scales)),
+        m_NumPositions((int)m_Positions.size()),
+        m_NumRotations((int)m_Rotations.size()),
+        m_NumScalings((int)m_Scales.size()),
+        m_LocalTransform(1.0f),
+        m_Name(name),
+        m_ID(ID)
+  {
+  }
+
+  /* Key indices a playback position was last found at. Kept by whoever plays the
+     clip, one per Bone, so many instances can sample a shared Animation at different
+     times, on different threads. */
+  struct Cursor
+  {
+    int position = 0;
+    int rotation = 0;
+    int scale = 0;
+  };
+
+  // local transform at animationTime; reads the keys and writes only cursor
+  glm::mat4 Evaluate(float animationTime, Cursor &cursor) const
+  {
+    glm::vec3 position, scale;
+    glm::quat rotation;
+    Sample(animationTime, cursor, position, rotation, scale);
+    return glm::translate(glm::mat4(1.0f), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1.0f), scale);
+  }
+
+  // the interpolated components at animationTime, e.g. to blend them with another clip
+  void Sample(float animationTime, Cursor &cursor, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale) const
+  {
+    position = SamplePosition(animationTime, cursor.position);
+    rotation = SampleRotation(animationTime, cursor.rotation);
+    scale = SampleScale(animationTime, cursor.scale);
+  }
+
+  /* Stores the keys around animationTime as slot of from and to, and how far between
+     them it lies in weights, for InterpolatePoses to evaluate many bones at once.
+     Gives the same pose as Sample. */
+  void GatherKeys(float animationTime, Cursor &cursor, PoseSoA &from, PoseSoA &to, PoseWeights &weights, int slot) const
+  {
+    glm::vec3 position0, position1, scale0, scale1;
+    glm::quat rotation0, rotation1;
+    FindKeys(m_Positions, &KeyPosition::position, m_PositionTrack, glm::vec3(0.0f), animationTime, cursor.position,
+             position0, position1, weights.translation[slot]);
+    FindKeys(m_Rotations, &KeyRotation::orientation, m_RotationTrack, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), animationTime,
+             cursor.rotation, rotation0, rotation1, weights.rotation[slot]);
+    FindKeys(m_Scales, &KeyScale::scale, m_ScaleTrack, glm::vec3(1.0f), animationTime, cursor.scale,
+             scale0, scale1, weights.scale[slot]);
+    from.Set(slot, position0, rotation0, scale0);
+    to.Set(slot, position1, rotation1, scale1);
+  }
+
+  /* Replaces the key vectors with compressed tracks, see clip_compression.h; sampling
+     decodes them from then on. Tracks that can't be compressed stay as they are.
+     Returns how many of the three tracks became constant. */
+  int Compress(const ClipCompressionSettings &settings)
+  {
+    int constantTracks = 0;
+    std::vector<float> times;
+    std::vector<glm::vec3> vectors;
+    std::vector<glm::quat> rotations;
+
+    for (const KeyPosition &key : m_Positions)
+      times.push_back(key.timeStamp), vectors.push_back(key.position);
+    if (CompressTrack(times, vectors, settings.positionTolerance, [](const glm::vec3 &v) { return v; }, m_PositionTrack))
+    {
+      constantTracks += m_PositionTrack.values.size() == 1;
+      std::vector<KeyPosition>().swap(m_Positions);
+      m_NumPositions = 0;
+    }
+
+    times.clear();
+    for (const KeyRotation &key : m_Rotations)
+      times.push_back(key.timeStamp), rotations.push_back(key.orientation);
+    if (CompressTrack(times, rotations, settings.rotationTolerance, PackQuat, m_RotationTrack))
+    {
+      constantTracks += m_RotationTrack.values.size() == 1;
+      std::vector<KeyRotation>().swap(m_Rotations);
+      m_NumRotations = 0;
+    }
+
+    times.clear();
+    vectors.clear();
+    for (const KeyScale &key : m_Scales)
+      times.push_back(key.timeStamp), vectors.push_back(key.scale);
+    if (CompressTrack(times, vectors, settings.scaleTolerance, [](const glm::vec3 &v) { return v; }, m_ScaleTrack))
+    {
+      constantTracks += m_ScaleTrack.values.size() == 1;
+      std::vector<KeyScale>().swap(m_Scales);
+      m_NumScalings = 0;
+    }
+    return constantTracks;
+  }
+
+  // bytes of key data, compressed or not
+  size_t GetMemoryBytes() const
+  {
+    size_t bytes = m_Positions.size() * sizeof(KeyPosition) + m_Rotations.size() * sizeof(KeyRotation) +
+                   m_Scales.size() * sizeof(KeyScale);
+    if (m_PositionTrack.IsCompressed())
+      bytes += m_PositionTrack.GetMemoryBytes();
+    if (m_RotationTrack.IsCompressed())
+      bytes += m_RotationTrack.GetMemoryBytes();
+    if (m_ScaleTrack.IsCompressed())
+      bytes += m_ScaleTrack.GetMemoryBytes();
+    return bytes;
+  }
+
+  // number of keys stored, compressed or not
+  int GetKeyCount() const
+  {
+    return (int)(m_Positions.size() + m_Rotations.size() + m_Scales.size() + m_PositionTrack.values.size() +
+                 m_RotationTrack.values.size() + m_ScaleTrack.values.size());
+  }
+
   void Update(float animationTime)
   {
     glm::vec3 tmp;
@@ -82,93 +207,79 @@ public:
   }
   glm::mat4 GetLocalTransform() { return m_LocalTransform; }
   std::string GetBoneName() const { return m_Name; }
-  int GetBoneID() { return m_ID; }
+  int GetBoneID() const { return m_ID; }
 
   int GetPositionIndex(float animationTime)
   {
-    for (int index = 0; index < m_NumPositions - 1; ++index)
-    {
-      if (animationTime < m_Positions[index + 1].timeStamp)
-        return index;
-    }
-    assert(0);
+    return FindKeyIndex(m_Positions, animationTime, m_LastPositionIndex);
   }
 
   int GetRotationIndex(float animationTime)
   {
-    for (int index = 0; index < m_NumRotations - 1; ++index)
-    {
-      if (animationTime < m_Rotations[index + 1].timeStamp)
-        return index;
-    }
-    assert(0);
+    return FindKeyIndex(m_Rotations, animationTime, m_LastRotationIndex);
   }
 
   int GetScaleIndex(float animationTime)
   {
-    for (int index = 0; index < m_NumScalings - 1; ++index)
-    {
-      if (animationTime < m_Scales[index + 1].timeStamp)
-        return index;
-    }
-    assert(0);
+    return FindKeyIndex(m_Scales, animationTime, m_LastScaleIndex);
   }
 
   // private:
 
-  float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
+  static float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
   {
     float scaleFactor = 0.0f;
     float midWayLength = animationTime - lastTimeStamp;
     float framesDiff = nextTimeStamp - lastTimeStamp;
+    if (framesDiff <= 0.0f)
+      return 0.0f;
     scaleFactor = midWayLength / framesDiff;
-    return scaleFactor;
+    // times before the first key or past the last one hold the end pose
+    return glm::clamp(scaleFactor, 0.0f, 1.0f);
   }
 
   glm::mat4 InterpolatePosition(float animationTime, glm::vec3 &finalPos)
   {
-    if (1 == m_NumPositions)
-      return glm::translate(glm::mat4(1.0f), m_Positions[0].position);
-
-    int p0Index = GetPositionIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor = GetScaleFactor(m_Positions[p0Index].timeStamp,
-                                       m_Positions[p1Index].timeStamp, animationTime);
-    glm::vec3 finalPosition = glm::mix(m_Positions[p0Index].position, m_Positions[p1Index].position, scaleFactor);
-    finalPos = finalPosition;
-    return glm::translate(glm::mat4(1.0f), finalPosition);
+    finalPos = SamplePosition(animationTime, m_LastPositionIndex);
+    return glm::translate(glm::mat4(1.0f), finalPos);
   }
 
   glm::mat4 InterpolateRotation(float animationTime, glm::quat &finalQuat)
   {
-    if (1 == m_NumRotations)
-    {
-      auto rotation = glm::normalize(m_Rotations[0].orientation);
-      return glm::toMat4(rotation);
-    }
-
-    int p0Index = GetRotationIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor = GetScaleFactor(m_Rotations[p0Index].timeStamp,
-                                       m_Rotations[p1Index].timeStamp, animationTime);
-    glm::quat finalRotation = glm::slerp(m_Rotations[p0Index].orientation, m_Rotations[p1Index].orientation, scaleFactor);
-    finalRotation = glm::normalize(finalRotation);
-    finalQuat = finalRotation;
-    return glm::toMat4(finalRotation);
+    finalQuat = SampleRotation(animationTime, m_LastRotationIndex);
+    return glm::toMat4(finalQuat);
   }
 
   glm::mat4 InterpolateScaling(float animationTime, glm::vec3 &finalScaling)
   {
-    if (1 == m_NumScalings)
-      return glm::scale(glm::mat4(1.0f), m_Scales[0].scale);
+    finalScaling = SampleScale(animationTime, m_LastScaleIndex);
+    return glm::scale(glm::mat4(1.0f), finalScaling);
+  }
 
-    int p0Index = GetScaleIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor = GetScaleFactor(m_Scales[p0Index].timeStamp,
-                                       m_Scales[p1Index].timeStamp, animationTime);
-    glm::vec3 finalScale = glm::mix(m_Scales[p0Index].scale, m_Scales[p1Index].scale, scaleFactor);
-    finalScaling = finalScale;
-    return glm::scale(glm::mat4(1.0f), finalScale);
+  // the track sampled at animationTime, starting the key search at lastIndex
+  glm::vec3 SamplePosition(float animationTime, int &lastIndex) const
+  {
+    glm::vec3 from, to;
+    float weight;
+    FindKeys(m_Positions, &KeyPosition::position, m_PositionTrack, glm::vec3(0.0f), animationTime, lastIndex, from, to, weight);
+    return glm::mix(from, to, weight);
+  }
+
+  glm::quat SampleRotation(float animationTime, int &lastIndex) const
+  {
+    glm::quat from, to;
+    float weight;
+    FindKeys(m_Rotations, &KeyRotation::orientation, m_RotationTrack, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), animationTime,
+             lastIndex, from, to, weight);
+    return glm::normalize(glm::slerp(from, to, weight));
+  }
+
+  glm::vec3 SampleScale(float animationTime, int &lastIndex) const
+  {
+    glm::vec3 from, to;
+    float weight;
+    FindKeys(m_Scales, &KeyScale::scale, m_ScaleTrack, glm::vec3(1.0f), animationTime, lastIndex, from, to, weight);
+    return glm::mix(from, to, weight);
   }
 
   std::vector<KeyPosition> m_Positions;
@@ -178,7 +289,76 @@ public:
   int m_NumRotations;
   int m_NumScalings;
 
+  // used instead of the key vectors above once Compress() took them
+  CompressedTrack<glm::vec3> m_PositionTrack;
+  CompressedTrack<PackedQuat> m_RotationTrack;
+  CompressedTrack<glm::vec3> m_ScaleTrack;
+
   glm::mat4 m_LocalTransform;
   std::string m_Name;
   int m_ID;
+
+private:
+  /* The keys around animationTime, from the compressed track if there is one, and how
+     far between them it lies. Tracks of one key give it twice with weight 0, empty
+     tracks the identity. */
+  template <typename Key, typename Value, typename Stored>
+  static void FindKeys(const std::vector<Key> &keys, Value Key::*field, const CompressedTrack<Stored> &track,
+                       const Value &identity, float animationTime, int &lastIndex, Value &from, Value &to, float &weight)
+  {
+    if (track.IsCompressed())
+    {
+      track.Keys(animationTime, lastIndex, from, to, weight);
+      return;
+    }
+    weight = 0.0f;
+    if (keys.empty())
+    {
+      from = to = identity;
+      return;
+    }
+    if (keys.size() == 1)
+    {
+      from = to = keys[0].*field;
+      return;
+    }
+    int index = FindKeyIndex(keys, animationTime, lastIndex);
+    from = keys[index].*field;
+    to = keys[index + 1].*field;
+    weight = GetScaleFactor(keys[index].timeStamp, keys[index + 1].timeStamp, animationTime);
+  }
+
+  /* Returns the index of the key starting the segment [index, index + 1] that
+     contains animationTime, clamped to the first/last segment of the track.
+     Playback mostly moves forward, so the segment found last time and the one
+     right after it are tried first; seeks and loops fall back to a binary search. */
+  template <typename Key>
+  static int FindKeyIndex(const std::vector<Key> &keys, float animationTime, int &lastIndex)
+  {
+    int lastSegment = static_cast<int>(keys.size()) - 2;
+    if (lastSegment <= 0)
+      return 0;
+
+    auto contains = [&](int index)
+    {
+      return (index == 0 || keys[index].timeStamp <= animationTime) &&
+             (index == lastSegment || animationTime < keys[index + 1].timeStamp);
+    };
+
+    if (lastIndex <= lastSegment && contains(lastIndex))
+      return lastIndex;
+    if (lastIndex < lastSegment && contains(lastIndex + 1))
+      return ++lastIndex;
+
+    // first key strictly after animationTime; the segment starts one before it
+    auto next = std::upper_bound(keys.begin() + 1, keys.begin() + lastSegment + 1, animationTime,
+                                 [](float time, const Key &key)
+                                 { return time < key.timeStamp; });
+    lastIndex = static_cast<int>(next - keys.begin()) - 1;
+    return lastIndex;
+  }
+
+  int m_LastPositionIndex = 0;
+  int m_LastRotationIndex = 0;
+  int m_LastScaleIndex = 0;
 };
@@ -0,0 +1,259 @@
+#pragma once
+
+/* Compressed key tracks for Bone. A track is compressed in four steps:
+
+   - a track that stays within tolerance of its first key keeps only that key;
+   - keys are placed on the track's frame grid, so a time is a 16 bit frame number,
+     and a track with a key on every frame stores no times at all;
+   - keys that linear interpolation (slerp for rotations) of their neighbours
+     reproduces within tolerance are dropped, greedily from the start;
+   - rotations are stored as smallest-three quaternions in 48 bits.
+
+   Tracks whose keys are not on a regular grid stay uncompressed. The error of a
+   kept track is measured against the original keys and includes quantization. */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct ClipCompressionSettings
+{
+  bool enabled = true;
+  float positionTolerance = 0.01f;  // in the units of the bone's parent space
+  float rotationTolerance = 5e-4f;  // radians, smallest three alone costs up to 1.3e-4
+  float scaleTolerance = 1e-4f;
+};
+
+// what compressing a clip did, see Animation::Compress
+struct ClipCompressionStats
+{
+  size_t bytesBefore = 0;     // key data only
+  size_t bytesAfter = 0;
+  int tracks = 0;
+  int constantTracks = 0;
+  int keysBefore = 0;
+  int keysAfter = 0;
+  float maxJointError = 0.0f; // largest distance of a joint to its uncompressed model space position
+};
+
+/* Smallest three: the largest component is dropped, made positive by negating the
+   quaternion, and rebuilt from the unit length. The other three lie in
+   [-1/sqrt(2), 1/sqrt(2)] and are kept in 15 bits each; the top bits of the first two
+   words hold the index of the dropped one. Off by at most 1.3e-4 radians. */
+struct PackedQuat
+{
+  uint16_t bits[3];
+};
+
+inline PackedQuat PackQuat(glm::quat q)
+{
+  q = glm::normalize(q);
+  float components[4] = { q.x, q.y, q.z, q.w };
+  int largest = 0;
+  for (int i = 1; i < 4; i++)
+    if (std::fabs(components[i]) > std::fabs(components[largest]))
+      largest = i;
+  float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+  PackedQuat packed;
+  for (int i = 0, slot = 0; i < 4; i++)
+  {
+    if (i == largest)
+      continue;
+    float normalized = glm::clamp(sign * components[i] * 0.70710678f + 0.5f, 0.0f, 1.0f);
+    packed.bits[slot++] = (uint16_t)std::lround(normalized * 32767.0f);
+  }
+  packed.bits[0] |= (uint16_t)((largest & 1) << 15);
+  packed.bits[1] |= (uint16_t)((largest >> 1) << 15);
+  return packed;
+}
+
+inline glm::quat UnpackQuat(const PackedQuat &packed)
+{
+  int largest = (packed.bits[0] >> 15) | ((packed.bits[1] >> 15) << 1);
+  float components[4];
+  float sum = 0.0f;
+  for (int i = 0, slot = 0; i < 4; i++)
+  {
+    if (i == largest)
+      continue;
+    components[i] = ((packed.bits[slot++] & 0x7fff) / 32767.0f - 0.5f) * 1.41421356f;
+    sum += components[i] * components[i];
+  }
+  components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+  return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+inline glm::vec3 DecodeKey(const glm::vec3 &value) { return value; }
+inline glm::quat DecodeKey(const PackedQuat &value) { return UnpackQuat(value); }
+
+// how keys are interpolated when sampling, the same as for uncompressed tracks
+inline glm::vec3 InterpolateKeys(const glm::vec3 &a, const glm::vec3 &b, float weight) { return glm::mix(a, b, weight); }
+inline glm::quat InterpolateKeys(const glm::quat &a, const glm::quat &b, float weight)
+{
+  return glm::normalize(glm::slerp(a, b, weight));
+}
+
+inline float KeyError(const glm::vec3 &a, const glm::vec3 &b) { return glm::length(a - b); }
+// angle between two rotations; atan2 stays accurate for tiny angles, unlike acos
+inline float KeyError(const glm::quat &a, const glm::quat &b)
+{
+  glm::quat difference = glm::conjugate(a) * b;
+  return 2.0f * std::atan2(glm::length(glm::vec3(difference.x, difference.y, difference.z)), std::fabs(difference.w));
+}
+
+/* A compressed track of Stored keys, glm::vec3 or PackedQuat. One value is a constant
+   track, no values an unused one. */
+template <typename Stored>
+struct CompressedTrack
+{
+  float startTime = 0.0f;      // time of frame 0, in ticks
+  float frameDuration = 1.0f;  // ticks from one frame to the next
+  std::vector<uint16_t> frames; // frame of every value; empty when values hold every frame
+  std::vector<Stored> values;
+
+  bool IsCompressed() const { return !values.empty(); }
+
+  size_t GetMemoryBytes() const
+  {
+    return sizeof(float) * 2 + frames.size() * sizeof(uint16_t) + values.size() * sizeof(Stored);
+  }
+
+  /* The decoded keys around time and how far between them it lies; lastIndex is the
+     caller's search start, as for the uncompressed tracks. */
+  template <typename Value>
+  void Keys(float time, int &lastIndex, Value &from, Value &to, float &weight) const
+  {
+    int count = (int)values.size();
+    weight = 0.0f;
+    if (count < 2)
+    {
+      from = to = DecodeKey(values[0]);
+      return;
+    }
+    float frame = (time - startTime) / frameDuration;
+    int index;
+    float frame0, frame1;
+    if (frames.empty())
+    {
+      index = glm::clamp((int)std::floor(frame), 0, count - 2);
+      frame0 = (float)index;
+      frame1 = (float)index + 1.0f;
+    }
+    else
+    {
+      index = FindFrame(frame, lastIndex);
+      frame0 = frames[index];
+      frame1 = frames[index + 1];
+    }
+    from = DecodeKey(values[index]);
+    to = DecodeKey(values[index + 1]);
+    weight = glm::clamp((frame - frame0) / (frame1 - frame0), 0.0f, 1.0f);
+  }
+
+private:
+  // segment [index, index + 1] of frames containing frame, trying lastIndex first
+  int FindFrame(float frame, int &lastIndex) const
+  {
+    int lastSegment = (int)frames.size() - 2;
+    auto contains = [&](int index)
+    {
+      return (index == 0 || frames[index] <= frame) && (index == lastSegment || frame < frames[index + 1]);
+    };
+    if (lastIndex <= lastSegment && contains(lastIndex))
+      return lastIndex;
+    if (lastIndex < lastSegment && contains(lastIndex + 1))
+      return ++lastIndex;
+    auto next = std::upper_bound(frames.begin() + 1, frames.begin() + lastSegment + 1, frame,
+                                 [](float value, uint16_t key) { return value < (float)key; });
+    lastIndex = (int)(next - frames.begin()) - 1;
+    return lastIndex;
+  }
+};
+
+/* Compresses the keys (times[i], values[i]) into track, encoding every kept value
+   with encode (a Value to Stored conversion). Returns false, leaving track empty,
+   when the keys aren't on a regular grid of at most 65536 frames. */
+template <typename Stored, typename Value, typename Encode>
+bool CompressTrack(const std::vector<float> &times, const std::vector<Value> &values, float tolerance,
+                   Encode encode, CompressedTrack<Stored> &track)
+{
+  track = CompressedTrack<Stored>();
+  int count = (int)values.size();
+  if (count == 0)
+    return false;
+
+  // the values as they will come back, so the tolerance covers quantization too
+  std::vector<Value> decoded(count);
+  for (int i = 0; i < count; i++)
+    decoded[i] = DecodeKey(encode(values[i]));
+
+  bool constant = true;
+  for (int i = 0; i < count && constant; i++)
+    constant = KeyError(decoded[0], values[i]) <= tolerance;
+  if (constant)
+  {
+    track.startTime = times[0];
+    track.values.push_back(encode(values[0]));
+    return true;
+  }
+
+  // the grid: the shortest step between keys, which every key has to sit on
+  float frameDuration = 0.0f;
+  for (int i = 1; i < count; i++)
+  {
+    float step = times[i] - times[i - 1];
+    if (step <= 0.0f)
+      return false;
+    frameDuration = i == 1 ? step : std::min(frameDuration, step);
+  }
+  std::vector<int> frames(count);
+  for (int i = 0; i < count; i++)
+  {
+    float frame = (times[i] - times[0]) / frameDuration;
+    frames[i] = (int)std::lround(frame);
+    if (std::fabs(frame - frames[i]) > 1e-3f || frames[i] > 65535)
+      return false;
+  }
+
+  // greedy key reduction: extend the segment from the last kept key as long as
+  // interpolating over it reproduces every original key it skips
+  std::vector<int> kept(1, 0);
+  for (int i = 1; i + 1 < count; i++)
+  {
+    int first = kept.back(), last = i + 1;
+    bool fits = true;
+    for (int j = first + 1; j < last && fits; j++)
+    {
+      float weight = (float)(frames[j] - frames[first]) / (float)(frames[last] - frames[first]);
+      fits = KeyError(InterpolateKeys(decoded[first], decoded[last], weight), values[j]) <= tolerance;
+    }
+    if (!fits)
+      kept.push_back(i);
+  }
+  kept.push_back(count - 1);
+
+  // frame numbers for the kept keys may cost more than the dropped keys saved
+  bool everyFrame = frames[kept.back()] == (int)kept.size() - 1;
+  if (!everyFrame && frames[count - 1] == count - 1 &&
+      kept.size() * (sizeof(Stored) + sizeof(uint16_t)) >= count * sizeof(Stored))
+  {
+    kept.resize(count);
+    for (int i = 0; i < count; i++)
+      kept[i] = i;
+    everyFrame = true;
+  }
+
+  track.startTime = times[0];
+  track.frameDuration = frameDuration;
+  for (int i : kept)
+  {
+    if (!everyFrame)
+      track.frames.push_back((uint16_t)frames[i]);
+    track.values.push_back(encode(values[i]));
+  }
+  return true;
+}
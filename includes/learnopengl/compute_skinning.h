@@ -0,0 +1,218 @@
+#ifndef COMPUTE_SKINNING_H
+#define COMPUTE_SKINNING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_pack.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_c.h>
+#include <learnopengl/skinning_palette.h>
+
+#include <algorithm>
+#include <vector>
+
+// a vertex after skinning, in model space
+struct SkinnedVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+// The skinning matrix of one vertex: its bone matrices blended by weight. Ids outside
+// [0, boneCount), like the -1 of unused slots in the Full layout, count as weight 0, and
+// weight missing from a sum of one leaves that share of the vertex unskinned. This is
+// what skinning.cs and the anim_model.vs of 8_skeletal_animation and 11_compute_skinning
+// compute. Before, weights summing to less than one pulled the vertex toward the model
+// origin and an id past the palette left the whole vertex unskinned; the assignments'
+// shaders still do that. Weights summing to one give the same result either way.
+inline glm::mat4 skinningMatrix(const int ids[MAX_BONE_INFLUENCE], const float weights[MAX_BONE_INFLUENCE],
+                                const glm::mat4 *bones, int boneCount)
+{
+    glm::mat4 skin(0.0f);
+    float skinnedWeight = 0.0f;
+    for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        float weight = ids[i] >= 0 && ids[i] < boneCount ? weights[i] : 0.0f;
+        skin += bones[std::clamp(ids[i], 0, boneCount - 1)] * weight;
+        skinnedWeight += weight;
+    }
+    return skin + glm::mat4(1.0f - skinnedWeight);
+}
+
+// CPU reference of the compute path: skins vertices as they are stored on the GPU in
+// format, so compact vertices are quantized first just like the shader sees them. The
+// result is meant to check ComputeSkinning::readBack against.
+inline void skinVerticesReference(VertexFormat format, const Vertex *vertices, size_t count, const glm::mat4 *bones,
+                                  int boneCount, vector<SkinnedVertex> &out)
+{
+    out.resize(count);
+    vector<unsigned char> encoded = encodeVertices(format, vertices, count);
+    const CompactSkinnedVertex *compact = reinterpret_cast<const CompactSkinnedVertex *>(encoded.data());
+    for(size_t v = 0; v < count; v++)
+    {
+        SkinnedVertex source;
+        int ids[MAX_BONE_INFLUENCE];
+        float weights[MAX_BONE_INFLUENCE];
+        if(format == VertexFormat::CompactSkinned)
+        {
+            source.Position = compact[v].base.Position;
+            source.Normal = octDecode(glm::unpackSnorm2x16(compact[v].base.Normal));
+            source.TexCoords = glm::unpackHalf2x16(compact[v].base.TexCoords);
+            source.Tangent = octDecode(glm::unpackSnorm2x16(compact[v].base.Tangent));
+            source.Bitangent = octDecode(glm::unpackSnorm2x16(compact[v].base.Bitangent));
+            glm::vec4 unpacked = glm::unpackUnorm4x8(compact[v].m_Weights);
+            for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+            {
+                ids[i] = compact[v].m_BoneIDs[i];
+                weights[i] = unpacked[i];
+            }
+        }
+        else
+        {
+            source.Position = vertices[v].Position;
+            source.Normal = vertices[v].Normal;
+            source.TexCoords = vertices[v].TexCoords;
+            source.Tangent = vertices[v].Tangent;
+            source.Bitangent = vertices[v].Bitangent;
+            std::copy(vertices[v].m_BoneIDs, vertices[v].m_BoneIDs + MAX_BONE_INFLUENCE, ids);
+            std::copy(vertices[v].m_Weights, vertices[v].m_Weights + MAX_BONE_INFLUENCE, weights);
+        }
+
+        glm::mat4 skin = skinningMatrix(ids, weights, bones, boneCount);
+        glm::mat3 rotation(skin);
+        out[v].Position = glm::vec3(skin * glm::vec4(source.Position, 1.0f));
+        out[v].Normal = glm::normalize(rotation * source.Normal);
+        out[v].TexCoords = source.TexCoords;
+        out[v].Tangent = glm::normalize(rotation * source.Tangent);
+        out[v].Bitangent = glm::normalize(rotation * source.Bitangent);
+    }
+}
+
+// One character's skinned copy of a packed model (Model::packMeshes), made on the GPU by
+// skinning.cs. The compute shader reads the pack's vertex buffer, CompactSkinned or Full,
+// with the bone matrices from a SkinningPalette, and writes CompactStatic vertices into
+// this object's buffer. Its vertex array pairs them with the pack's index buffer, so every
+// pass of the frame (shadow, depth prepass, main) draws the character as a static mesh
+// instead of skinning it again in the vertex shader:
+//
+//   skinning.skin(skinningShader, palette, character);   // for every character
+//   ComputeSkinning::barrier();                            // once, before the first draw
+//   skinning.Draw(staticShader);                           // in every pass
+//
+// The static shader reads the CompactStatic layout, see vertex_layout.h. Needs GL 4.3.
+class ComputeSkinning
+{
+public:
+    static const GLuint SOURCE_BINDING = 0;
+    static const GLuint TARGET_BINDING = 1;
+    static const GLuint GROUP_SIZE = 64; // local_size_x of skinning.cs
+
+    ComputeSkinning() = default;
+    ComputeSkinning(const ComputeSkinning &) = delete;
+    ComputeSkinning &operator=(const ComputeSkinning &) = delete;
+
+    ~ComputeSkinning()
+    {
+        if(!VAO || !glfwGetCurrentContext())
+            return;
+        GLStateCache::get().forgetVertexArray(VAO);
+        glDeleteBuffers(1, &outputBuffer);
+        glDeleteVertexArrays(1, &VAO);
+    }
+
+    static bool supported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // makes the output buffer for model, whose meshes have to be packed and skinned
+    template <typename ModelType>
+    bool build(ModelType &model)
+    {
+        if(!supported() || !model.pack.isBuilt() || model.vertexFormat == VertexFormat::CompactStatic)
+            return false;
+        meshes = &model.meshes;
+        pack = &model.pack;
+        sourceFormat = model.vertexFormat;
+        vertexCount = 0;
+        for(size_t i = 0; i < model.meshes.size(); i++)
+            vertexCount = std::max(vertexCount, (GLuint)pack->ranges[i].baseVertex + model.meshes[i].vertexCount);
+
+        glGenBuffers(1, &outputBuffer);
+        glGenVertexArrays(1, &VAO);
+        GLStateCache::get().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, outputBuffer);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCount * sizeof(CompactStaticVertex), nullptr, GL_DYNAMIC_COPY);
+        vertexLayout(VertexFormat::CompactStatic).apply();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pack->indexBuffer());
+        GLStateCache::get().bindVertexArray(0);
+        return true;
+    }
+
+    bool isBuilt() const
+    {
+        return VAO != 0;
+    }
+
+    // skins the vertices with the palette of character; shader is skinning.cs and has to be
+    // bound to the palette once with SkinningPalette::BindShader
+    void skin(ComputeShader &shader, const SkinningPalette &palette, int character = 0)
+    {
+        shader.use();
+        shader.setInt("vertexCount", (int)vertexCount);
+        shader.setBool("compactSource", sourceFormat == VertexFormat::CompactSkinned);
+        palette.Bind(character);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SOURCE_BINDING, pack->vertexBuffer());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TARGET_BINDING, outputBuffer);
+        glDispatchCompute((vertexCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    }
+
+    // makes the vertices written by skin() visible to draws and readBack; one call after
+    // skinning every character of the frame is enough
+    static void barrier()
+    {
+        glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    // draws the skinned vertices like Model::Draw draws the model
+    void Draw(Shader &shader, int lod = 0)
+    {
+        pack->drawRanges(VAO, shader, *meshes, lod);
+    }
+
+    // the skinned vertices decoded from the output buffer, to compare with skinVerticesReference
+    void readBack(vector<SkinnedVertex> &out) const
+    {
+        vector<CompactStaticVertex> stored(vertexCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, outputBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)vertexCount * sizeof(CompactStaticVertex), stored.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        out.resize(vertexCount);
+        for(GLuint v = 0; v < vertexCount; v++)
+        {
+            out[v].Position = stored[v].Position;
+            out[v].Normal = octDecode(glm::unpackSnorm2x16(stored[v].Normal));
+            out[v].TexCoords = glm::unpackHalf2x16(stored[v].TexCoords);
+            out[v].Tangent = octDecode(glm::unpackSnorm2x16(stored[v].Tangent));
+            out[v].Bitangent = octDecode(glm::unpackSnorm2x16(stored[v].Bitangent));
+        }
+    }
+
+    GLuint getVertexCount() const { return vertexCount; }
+
+private:
+    vector<Mesh> *meshes = nullptr;
+    MeshPack *pack = nullptr;
+    VertexFormat sourceFormat = VertexFormat::CompactSkinned;
+    GLuint vertexCount = 0;
+    unsigned int VAO = 0, outputBuffer = 0;
+};
+#endif
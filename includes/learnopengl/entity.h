@@ -6,6 +6,8 @@
 #include <array> //std::array
 #include <memory> //std::unique_ptr
 
+#include <learnopengl/indirect_renderer.h>
+
 class Transform
 {
 protected:
@@ -348,16 +350,9 @@ AABB generateAABB(const Model& model)
 	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
 	for (auto&& mesh : model.meshes)
 	{
-		for (auto&& vertex : mesh.vertices)
-		{
-			minAABB.x = std::min(minAABB.x, vertex.Position.x);
-			minAABB.y = std::min(minAABB.y, vertex.Position.y);
-			minAABB.z = std::min(minAABB.z, vertex.Position.z);
-
-			maxAABB.x = std::max(maxAABB.x, vertex.Position.x);
-			maxAABB.y = std::max(maxAABB.y, vertex.Position.y);
-			maxAABB.z = std::max(maxAABB.z, vertex.Position.z);
-		}
+		// per-mesh bounds survive Mesh::releaseCpuData()
+		minAABB = glm::min(minAABB, mesh.minBounds);
+		maxAABB = glm::max(maxAABB, mesh.maxBounds);
 	}
 	return AABB(minAABB, maxAABB);
 }
@@ -368,16 +363,9 @@ Sphere generateSphereBV(const Model& model)
 	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
 	for (auto&& mesh : model.meshes)
 	{
-		for (auto&& vertex : mesh.vertices)
-		{
-			minAABB.x = std::min(minAABB.x, vertex.Position.x);
-			minAABB.y = std::min(minAABB.y, vertex.Position.y);
-			minAABB.z = std::min(minAABB.z, vertex.Position.z);
-
-			maxAABB.x = std::max(maxAABB.x, vertex.Position.x);
-			maxAABB.y = std::max(maxAABB.y, vertex.Position.y);
-			maxAABB.z = std::max(maxAABB.z, vertex.Position.z);
-		}
+		// per-mesh bounds survive Mesh::releaseCpuData()
+		minAABB = glm::min(minAABB, mesh.minBounds);
+		maxAABB = glm::max(maxAABB, mesh.maxBounds);
 	}
 
 	return Sphere((maxAABB + minAABB) * 0.5f, glm::length(minAABB - maxAABB));
@@ -396,6 +384,9 @@ public:
 	Model* pModel = nullptr;
 	std::unique_ptr<AABB> boundingVolume;
 
+	//Level of detail drawn last frame, kept per entity for the hysteresis of Model::selectLod
+	int lod = 0;
+
 
 	// constructor, expects a filepath to a 3D model.
 	Entity(Model& model) : pModel{ &model }
@@ -466,19 +457,40 @@ public:
 	}
 
 
-	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total)
+	//Without a lodView everything draws at full detail
+	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total, const LodView* lodView = nullptr)
 	{
 		if (boundingVolume->isOnFrustum(frustum, transform))
 		{
+			if (lodView)
+				lod = pModel->selectLod(transform.getModelMatrix(), *lodView, lod);
 			ourShader.setMat4("model", transform.getModelMatrix());
-			pModel->Draw(ourShader);
+			pModel->Draw(ourShader, lodView ? lod : 0);
+			display++;
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, ourShader, display, total, lodView);
+		}
+	}
+
+	//Same as drawSelfAndChild, but only queues the visible entities; renderer.submit() draws them
+	void collectSelfAndChild(const Frustum& frustum, IndirectRenderer& renderer, unsigned int& display, unsigned int& total, const LodView* lodView = nullptr)
+	{
+		if (pModel && boundingVolume->isOnFrustum(frustum, transform))
+		{
+			if (lodView)
+				lod = pModel->selectLod(transform.getModelMatrix(), *lodView, lod);
+			renderer.add(*pModel, transform.getModelMatrix(), lodView ? lod : 0);
 			display++;
 		}
 		total++;
 
 		for (auto&& child : children)
 		{
-			child->drawSelfAndChild(frustum, ourShader, display, total);
+			child->collectSelfAndChild(frustum, renderer, display, total, lodView);
 		}
 	}
 };
@@ -0,0 +1,121 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+// remembers the program, vertex array and 2D texture per unit last bound through it, so
+// binding the same object again is skipped. It only knows about binds made through it, so
+// once it is in use every glUseProgram, glBindVertexArray, glActiveTexture and
+// glBindTexture(GL_TEXTURE_2D) has to go through it as well; code that can't, like a
+// library or an old demo, must call invalidate() after its plain GL binds. Objects it may
+// have recorded must be forgotten before they are deleted, see forgetVertexArray and
+// forgetTexture. Shader::use and Mesh::Draw already bind through it.
+class GLStateCache
+{
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+    // number of binds passed on to GL and number skipped as redundant
+    unsigned long bindsIssued = 0;
+    unsigned long bindsSkipped = 0;
+
+    static GLStateCache &get()
+    {
+        static GLStateCache state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (programValid && currentProgram == program)
+        {
+            bindsSkipped++;
+            return;
+        }
+        glUseProgram(program);
+        currentProgram = program;
+        programValid = true;
+        bindsIssued++;
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if (vaoValid && currentVAO == vao)
+        {
+            bindsSkipped++;
+            return;
+        }
+        glBindVertexArray(vao);
+        currentVAO = vao;
+        vaoValid = true;
+        bindsIssued++;
+    }
+
+    // call before deleting a vertex array, GL may hand its name out again
+    void forgetVertexArray(GLuint vao)
+    {
+        if (currentVAO == vao)
+            vaoValid = false;
+    }
+
+    void activeTexture(unsigned int unit)
+    {
+        if (activeUnitValid && activeUnit == unit)
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+        activeUnitValid = true;
+    }
+
+    void bindTexture(unsigned int unit, GLuint texture)
+    {
+        if (unit < MAX_TEXTURE_UNITS && textureValid[unit] && boundTextures[unit] == texture)
+        {
+            bindsSkipped++;
+            return;
+        }
+        activeTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (unit < MAX_TEXTURE_UNITS)
+        {
+            boundTextures[unit] = texture;
+            textureValid[unit] = true;
+        }
+        bindsIssued++;
+    }
+
+    // call before deleting a texture, GL may hand its name out again
+    void forgetTexture(GLuint texture)
+    {
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+            if (boundTextures[i] == texture)
+                textureValid[i] = false;
+    }
+
+    // forget everything, the next bind of each kind always reaches GL
+    void invalidate()
+    {
+        programValid = false;
+        vaoValid = false;
+        activeUnitValid = false;
+        for (unsigned int i = 0; i < MAX_TEXTURE_UNITS; i++)
+            textureValid[i] = false;
+    }
+
+    void resetCounters()
+    {
+        bindsIssued = 0;
+        bindsSkipped = 0;
+    }
+
+private:
+    GLuint currentProgram = 0;
+    GLuint currentVAO = 0;
+    unsigned int activeUnit = 0;
+    GLuint boundTextures[MAX_TEXTURE_UNITS] = {};
+    bool programValid = false;
+    bool vaoValid = false;
+    bool activeUnitValid = false;
+    bool textureValid[MAX_TEXTURE_UNITS] = {};
+};
+#endif
@@ -0,0 +1,307 @@
+#ifndef INDIRECT_RENDERER_H
+#define INDIRECT_RENDERER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_pack.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+// the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Draws many instances of packed models (Model::packMeshes) with a handful of multi-draw
+// indirect calls. Per frame: begin(), add() every visible object, submit(). Objects of the
+// same model and level of detail become one command per mesh with an instance per object;
+// commands are then grouped by vertex array and textures, and every group is one
+// glMultiDrawElementsIndirect.
+//
+// The model matrices go to a shader storage buffer at binding MATRIX_BINDING. The vertex
+// shader finds its matrix through an instanced attribute at INSTANCE_ATTRIBUTE, which
+// holds 0, 1, 2, ... and is offset by the command's baseInstance:
+//
+//   layout(location = 7) in uint instanceIndex;
+//   layout(std430, binding = 0) buffer ModelMatrices { mat4 models[]; };
+//   ... models[instanceIndex] ...
+//
+// Needs GL 4.3. Without it, or for models that aren't packed, submit() falls back to one
+// "model" uniform and Model::Draw per object; pass the shader for that path to submit too.
+class IndirectRenderer
+{
+public:
+    static const GLuint INSTANCE_ATTRIBUTE = 7;
+    static const GLuint MATRIX_BINDING = 0;
+
+    // filled by submit(): GL draw calls issued, objects drawn and CPU time spent
+    unsigned int drawCalls = 0;
+    unsigned int instances = 0;
+    double submitMs = 0.0;
+
+    IndirectRenderer() = default;
+    IndirectRenderer(const IndirectRenderer &) = delete;
+    IndirectRenderer &operator=(const IndirectRenderer &) = delete;
+
+    ~IndirectRenderer()
+    {
+        if(!glfwGetCurrentContext())
+            return;
+        GLuint buffers[3] = { matrixBuffer, commandBuffer, instanceBuffer };
+        glDeleteBuffers(3, buffers);
+    }
+
+    static bool supported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    // forces the fallback path, e.g. to compare against it
+    bool useIndirect = true;
+
+    void begin()
+    {
+        for(Batch &batch : batches)
+            batch.matrices.clear();
+        fallback.clear();
+    }
+
+    // queues one object; model is a Model, drawn at level of detail lod
+    template <typename ModelType>
+    void add(ModelType &model, const glm::mat4 &modelMatrix, int lod = 0)
+    {
+        if(!useIndirect || !supported() || !model.pack.isBuilt())
+        {
+            fallback.push_back({ [&model](Shader &shader, int level) { model.Draw(shader, level); }, modelMatrix, lod });
+            return;
+        }
+        for(Batch &batch : batches)
+            if(batch.pack == &model.pack && batch.lod == lod)
+            {
+                batch.matrices.push_back(modelMatrix);
+                return;
+            }
+        Batch batch;
+        batch.pack = &model.pack;
+        batch.meshes = &model.meshes;
+        batch.lod = lod;
+        batch.matrices.push_back(modelMatrix);
+        batches.push_back(std::move(batch));
+    }
+
+    // draws everything added since begin(). indirectShader reads its matrices as described
+    // above, fallbackShader takes a "model" uniform; either may be the other's program if
+    // only one path can happen.
+    void submit(Shader &indirectShader, Shader &fallbackShader)
+    {
+        auto start = std::chrono::steady_clock::now();
+        drawCalls = 0;
+        instances = 0;
+        if(hasIndirectWork())
+            submitIndirect(indirectShader);
+        if(!fallback.empty())
+        {
+            GLStateCache::get().useProgram(fallbackShader.ID);
+            for(const FallbackDraw &draw : fallback)
+            {
+                fallbackShader.setMat4("model", draw.modelMatrix);
+                draw.draw(fallbackShader, draw.lod);
+                drawCalls++;
+            }
+            instances += (unsigned int)fallback.size();
+        }
+        submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // reads the instance buffer back and checks that every instance of the last submit()
+    // fetches an index inside it that points at its own batch's matrices
+    bool checkInstances() const
+    {
+        if(commands.empty())
+            return true;
+        vector<GLuint> indices(instanceCapacity);
+        glBindBuffer(GL_COPY_READ_BUFFER, instanceBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)(instanceCapacity * sizeof(GLuint)), indices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        for(const DrawElementsIndirectCommand &command : commands)
+        {
+            if(command.baseInstance + command.instanceCount > instanceCapacity)
+                return false;
+            for(GLuint i = 0; i < command.instanceCount; i++)
+            {
+                GLuint index = indices[command.baseInstance + i];
+                if(index != command.baseInstance + i || index >= matrices.size())
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // drops batches of models that may have been destroyed; call when models go away
+    void clear()
+    {
+        batches.clear();
+        fallback.clear();
+        preparedArrays.clear();
+    }
+
+private:
+    // the objects of one packed model at one level of detail; kept across frames so the
+    // matrix vectors keep their memory
+    struct Batch {
+        MeshPack *pack = nullptr;
+        vector<Mesh> *meshes = nullptr;
+        int lod = 0;
+        vector<glm::mat4> matrices;
+    };
+    vector<Batch> batches;
+
+    struct FallbackDraw {
+        std::function<void(Shader &, int)> draw;
+        glm::mat4 modelMatrix;
+        int lod;
+    };
+    vector<FallbackDraw> fallback;
+
+    // commands sharing a vertex array and textures, and a mesh to bind the textures with
+    struct Group {
+        GLuint vertexArray;
+        Mesh *material;
+        vector<DrawElementsIndirectCommand> commands;
+    };
+
+    GLuint matrixBuffer = 0, commandBuffer = 0, instanceBuffer = 0;
+    GLsizeiptr matrixCapacity = 0, commandCapacity = 0;
+    GLuint instanceCapacity = 0;
+    vector<GLuint> preparedArrays;      // vertex arrays that have the instance attribute
+    vector<glm::mat4> matrices;
+    vector<DrawElementsIndirectCommand> commands;
+
+    bool hasIndirectWork() const
+    {
+        for(const Batch &batch : batches)
+            if(!batch.matrices.empty())
+                return true;
+        return false;
+    }
+
+    void submitIndirect(Shader &shader)
+    {
+        // one command per mesh and batch, grouped by vertex array and texture set
+        std::map<std::pair<GLuint, vector<unsigned int>>, Group> groups;
+        matrices.clear();
+        for(Batch &batch : batches)
+        {
+            if(batch.matrices.empty())
+                continue;
+            GLuint baseInstance = (GLuint)matrices.size();
+            matrices.insert(matrices.end(), batch.matrices.begin(), batch.matrices.end());
+            vector<Mesh> &meshes = *batch.meshes;
+            for(size_t i = 0; i < meshes.size() && i < batch.pack->ranges.size(); i++)
+            {
+                const MeshLod &level = meshes[i].getLod(batch.lod);
+                DrawElementsIndirectCommand command;
+                command.count = level.indexCount;
+                command.instanceCount = (GLuint)batch.matrices.size();
+                command.firstIndex = batch.pack->ranges[i].firstIndex + level.indexOffset;
+                command.baseVertex = batch.pack->ranges[i].baseVertex;
+                command.baseInstance = baseInstance;
+
+                vector<unsigned int> textures;
+                for(const Texture &texture : meshes[i].textures)
+                    textures.push_back(texture.id);
+                Group &group = groups[std::make_pair(batch.pack->vertexArray(), std::move(textures))];
+                if(group.commands.empty())
+                {
+                    group.vertexArray = batch.pack->vertexArray();
+                    group.material = &meshes[i];
+                }
+                group.commands.push_back(command);
+            }
+            instances += (unsigned int)batch.matrices.size();
+        }
+        commands.clear();
+        for(auto &group : groups)
+            commands.insert(commands.end(), group.second.commands.begin(), group.second.commands.end());
+
+        upload(GL_SHADER_STORAGE_BUFFER, matrixBuffer, matrixCapacity, matrices.data(), (GLsizeiptr)(matrices.size() * sizeof(glm::mat4)));
+        upload(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commandCapacity, commands.data(),
+               (GLsizeiptr)(commands.size() * sizeof(DrawElementsIndirectCommand)));
+        growInstanceBuffer((GLuint)matrices.size());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATRIX_BINDING, matrixBuffer);
+
+        GLStateCache &state = GLStateCache::get();
+        state.useProgram(shader.ID);
+        size_t offset = 0;
+        for(auto &entry : groups)
+        {
+            Group &group = entry.second;
+            prepareVertexArray(group.vertexArray);
+            state.bindVertexArray(group.vertexArray);
+            group.material->bindTextures(shader);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(offset * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)group.commands.size(), 0);
+            offset += group.commands.size();
+            drawCalls++;
+        }
+        state.activeTexture(0);
+    }
+
+    // orphans and refills buffer, growing it by doubling
+    static void upload(GLenum target, GLuint &buffer, GLsizeiptr &capacity, const void *data, GLsizeiptr bytes)
+    {
+        if(!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        if(bytes > capacity)
+            capacity = std::max(bytes, capacity * 2);
+        glBufferData(target, capacity, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(target, 0, bytes, data);
+    }
+
+    // the instance attribute counts 0, 1, 2, ...; GL fetches it at baseInstance + instance, so
+    // it has to be as long as all batches together
+    void growInstanceBuffer(GLuint count)
+    {
+        if(count <= instanceCapacity)
+            return;
+        instanceCapacity = std::max(count, instanceCapacity * 2);
+        vector<GLuint> indices(instanceCapacity);
+        for(GLuint i = 0; i < instanceCapacity; i++)
+            indices[i] = i;
+        if(!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+
+    // adds the instance attribute to a pack's vertex array the first time we draw from it
+    void prepareVertexArray(GLuint vertexArray)
+    {
+        for(GLuint prepared : preparedArrays)
+            if(prepared == vertexArray)
+                return;
+        GLStateCache::get().bindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glEnableVertexAttribArray(INSTANCE_ATTRIBUTE);
+        glVertexAttribIPointer(INSTANCE_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+        glVertexAttribDivisor(INSTANCE_ATTRIBUTE, 1);
+        preparedArrays.push_back(vertexArray);
+    }
+};
+#endif
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed pool of worker threads for data parallel frame work. ParallelFor cuts a range
+   into chunks and deals them out to one queue per thread; every thread works through
+   its own queue from the front and, once that is empty, steals from the back of the
+   others, so uneven chunks still keep every core busy. The calling thread takes part,
+   a pool of one thread runs everything inline.
+
+   One ParallelFor at a time: jobs must not start another one. */
+class JobSystem
+{
+public:
+  // threadCount includes the calling thread; 0 uses every hardware thread
+  explicit JobSystem(int threadCount = 0)
+  {
+    if (threadCount <= 0)
+      threadCount = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int i = 0; i < threadCount; i++)
+      m_Queues.push_back(std::make_unique<Queue>());
+    for (int i = 1; i < threadCount; i++)
+      m_Workers.emplace_back([this, i]() { WorkerLoop(i); });
+  }
+
+  ~JobSystem()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_WakeMutex);
+      m_Stop = true;
+    }
+    m_Wake.notify_all();
+    for (std::thread &worker : m_Workers)
+      worker.join();
+  }
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  int GetThreadCount() const { return (int)m_Queues.size(); }
+
+  // calls job(begin, end) for consecutive chunks of at most grain items covering
+  // [0, count) and returns once all of them have run
+  void ParallelFor(int count, int grain, const std::function<void(int, int)> &job)
+  {
+    if (count <= 0)
+      return;
+    grain = std::max(grain, 1);
+    int chunks = (count + grain - 1) / grain;
+    if (m_Workers.empty() || chunks == 1)
+    {
+      for (int begin = 0; begin < count; begin += grain)
+        job(begin, std::min(begin + grain, count));
+      return;
+    }
+
+    m_Job = &job;
+    m_Remaining.store(chunks, std::memory_order_relaxed);
+    // consecutive chunks go to the same thread, they likely touch neighbouring memory
+    int threadCount = GetThreadCount();
+    for (int thread = 0; thread < threadCount; thread++)
+    {
+      Queue &queue = *m_Queues[thread];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      for (int chunk = chunks * thread / threadCount; chunk < chunks * (thread + 1) / threadCount; chunk++)
+        queue.ranges.push_back({ chunk * grain, std::min((chunk + 1) * grain, count) });
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_WakeMutex);
+      m_Generation++;
+    }
+    m_Wake.notify_all();
+
+    RunChunks(0);
+    // the last chunks may still run on workers
+    while (m_Remaining.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+    m_Job = nullptr;
+  }
+
+private:
+  struct Range
+  {
+    int begin, end;
+  };
+
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Range> ranges;
+  };
+
+  std::vector<std::unique_ptr<Queue>> m_Queues; // [0] belongs to the thread calling ParallelFor
+  std::vector<std::thread> m_Workers;
+  const std::function<void(int, int)> *m_Job = nullptr;
+  std::atomic<int> m_Remaining{0};
+
+  std::mutex m_WakeMutex;
+  std::condition_variable m_Wake;
+  unsigned long long m_Generation = 0; // bumped by every ParallelFor
+  bool m_Stop = false;
+
+  // own queue from the front, then the others from the back
+  bool PopRange(int thread, Range &range)
+  {
+    int threadCount = GetThreadCount();
+    for (int i = 0; i < threadCount; i++)
+    {
+      Queue &queue = *m_Queues[(thread + i) % threadCount];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.ranges.empty())
+        continue;
+      if (i == 0)
+      {
+        range = queue.ranges.front();
+        queue.ranges.pop_front();
+      }
+      else
+      {
+        range = queue.ranges.back();
+        queue.ranges.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void RunChunks(int thread)
+  {
+    Range range;
+    while (PopRange(thread, range))
+    {
+      (*m_Job)(range.begin, range.end);
+      m_Remaining.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void WorkerLoop(int thread)
+  {
+    unsigned long long seen = 0;
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        m_Wake.wait(lock, [&]() { return m_Stop || m_Generation != seen; });
+        if (m_Stop)
+          return;
+        seen = m_Generation;
+      }
+      RunChunks(thread);
+    }
+  }
+};
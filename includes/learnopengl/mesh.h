@@ -2,11 +2,15 @@
 #define MESH_H
 
 #include <glad/glad.h> // holds all OpenGL type declarations
+#include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh_lod.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_layout.h>
 
 #include <string>
 #include <vector>
@@ -31,42 +35,301 @@ struct Vertex {
 	float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// GPU side vertices of the compact formats, see vertex_layout.h
+struct CompactStaticVertex {
+    glm::vec3 Position;
+    uint32_t Normal;    // octahedral snorm16x2
+    uint32_t TexCoords; // half2
+    uint32_t Tangent;   // octahedral snorm16x2
+    uint32_t Bitangent; // octahedral snorm16x2
+};
+
+struct CompactSkinnedVertex {
+    CompactStaticVertex base;
+    uint8_t m_BoneIDs[MAX_BONE_INFLUENCE];
+    uint32_t m_Weights; // unorm8x4
+};
+
+// attribute locations match the Full layout, so shaders only change how they read normals
+inline const VertexLayout &vertexLayout(VertexFormat format)
+{
+    static const VertexLayout full = { sizeof(Vertex), {
+        { 0, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, Position) },
+        { 1, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, Normal) },
+        { 2, 2, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, TexCoords) },
+        { 3, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, Tangent) },
+        { 4, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, Bitangent) },
+        { 5, 4, GL_INT, GL_FALSE, true, offsetof(Vertex, m_BoneIDs) },
+        { 6, 4, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, m_Weights) } } };
+    static const VertexLayout compactStatic = { sizeof(CompactStaticVertex), {
+        { 0, 3, GL_FLOAT, GL_FALSE, false, offsetof(CompactStaticVertex, Position) },
+        { 1, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactStaticVertex, Normal) },
+        { 2, 2, GL_HALF_FLOAT, GL_FALSE, false, offsetof(CompactStaticVertex, TexCoords) },
+        { 3, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactStaticVertex, Tangent) },
+        { 4, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactStaticVertex, Bitangent) } } };
+    static const VertexLayout compactSkinned = { sizeof(CompactSkinnedVertex), {
+        { 0, 3, GL_FLOAT, GL_FALSE, false, offsetof(CompactSkinnedVertex, base) + offsetof(CompactStaticVertex, Position) },
+        { 1, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactSkinnedVertex, base) + offsetof(CompactStaticVertex, Normal) },
+        { 2, 2, GL_HALF_FLOAT, GL_FALSE, false, offsetof(CompactSkinnedVertex, base) + offsetof(CompactStaticVertex, TexCoords) },
+        { 3, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactSkinnedVertex, base) + offsetof(CompactStaticVertex, Tangent) },
+        { 4, 2, GL_SHORT, GL_TRUE, false, offsetof(CompactSkinnedVertex, base) + offsetof(CompactStaticVertex, Bitangent) },
+        { 5, 4, GL_UNSIGNED_BYTE, GL_FALSE, true, offsetof(CompactSkinnedVertex, m_BoneIDs) },
+        { 6, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, offsetof(CompactSkinnedVertex, m_Weights) } } };
+    switch(format)
+    {
+    case VertexFormat::CompactStatic: return compactStatic;
+    case VertexFormat::CompactSkinned: return compactSkinned;
+    default: return full;
+    }
+}
+
+inline CompactStaticVertex compactStaticVertex(const Vertex &vertex)
+{
+    CompactStaticVertex compact;
+    compact.Position = vertex.Position;
+    compact.Normal = packOctSnorm16(vertex.Normal);
+    compact.TexCoords = glm::packHalf2x16(vertex.TexCoords);
+    compact.Tangent = packOctSnorm16(vertex.Tangent);
+    compact.Bitangent = packOctSnorm16(vertex.Bitangent);
+    return compact;
+}
+
+// the vertices in the GPU layout of format; empty for Full, which uploads Vertex as is
+inline vector<unsigned char> encodeVertices(VertexFormat format, const Vertex *vertices, size_t count)
+{
+    vector<unsigned char> encoded(count * vertexLayout(format).stride);
+    if(format == VertexFormat::CompactStatic)
+    {
+        CompactStaticVertex *out = reinterpret_cast<CompactStaticVertex *>(encoded.data());
+        for(size_t i = 0; i < count; i++)
+            out[i] = compactStaticVertex(vertices[i]);
+    }
+    else if(format == VertexFormat::CompactSkinned)
+    {
+        CompactSkinnedVertex *out = reinterpret_cast<CompactSkinnedVertex *>(encoded.data());
+        for(size_t i = 0; i < count; i++)
+        {
+            out[i].base = compactStaticVertex(vertices[i]);
+            float weights[MAX_BONE_INFLUENCE];
+            for(int j = 0; j < MAX_BONE_INFLUENCE; j++)
+            {
+                bool used = vertices[i].m_BoneIDs[j] >= 0 && vertices[i].m_BoneIDs[j] <= 255;
+                out[i].m_BoneIDs[j] = used ? (uint8_t)vertices[i].m_BoneIDs[j] : 0;
+                weights[j] = used ? vertices[i].m_Weights[j] : 0.0f;
+            }
+            out[i].m_Weights = packWeightsUnorm8(weights);
+        }
+    }
+    else
+        encoded.clear();
+    return encoded;
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// owns its VAO/VBO/EBO, so it can be moved but not copied
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data, vertices and indices are empty after releaseCpuData(). indices holds every
+    // level of detail back to back, lods says where each one starts.
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    unsigned int VAO = 0;
+    unsigned int indexCount = 0;
+    unsigned int vertexCount = 0;
+    // index ranges of the levels of detail, finest first, at least one
+    vector<MeshLod> lods;
+    // layout of the vertices in the VBO; the CPU copy always stays a Vertex
+    VertexFormat format = VertexFormat::Full;
+    // object-space bounds of the vertices, kept when the CPU data is released
+    glm::vec3 minBounds = glm::vec3(0.0f);
+    glm::vec3 maxBounds = glm::vec3(0.0f);
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor, takes ownership of the data. Unless keepCpuData is set, the vertices
+    // and indices are dropped once they've been uploaded.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool keepCpuData = true,
+         VertexFormat format = VertexFormat::Full)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), format(format)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        if(!keepCpuData)
+            releaseCpuData();
+    }
+
+    // constructor for data that lives elsewhere, e.g. a memory-mapped baked model. The data
+    // is uploaded straight from the given arrays and only copied when keepCpuData is set.
+    Mesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexDataCount,
+         vector<Texture> textures, bool keepCpuData = true, VertexFormat format = VertexFormat::Full)
+        : textures(std::move(textures)), format(format)
+    {
+        setupMesh(vertexData, vertexCount, indexData, indexDataCount);
+        if(keepCpuData)
+        {
+            vertices.assign(vertexData, vertexData + vertexCount);
+            indices.assign(indexData, indexData + indexDataCount);
+        }
+    }
+
+    ~Mesh()
+    {
+        freeBuffers();
+    }
+
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    Mesh(Mesh &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Mesh &operator=(Mesh &&other) noexcept
+    {
+        if(this != &other)
+        {
+            freeBuffers();
+            vertices = std::move(other.vertices);
+            indices = std::move(other.indices);
+            textures = std::move(other.textures);
+            programBindings = std::move(other.programBindings);
+            VAO = other.VAO;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            indexCount = other.indexCount;
+            vertexCount = other.vertexCount;
+            lods = std::move(other.lods);
+            format = other.format;
+            minBounds = other.minBounds;
+            maxBounds = other.maxBounds;
+
+            other.VAO = 0;
+            other.VBO = 0;
+            other.EBO = 0;
+            other.indexCount = 0;
+            other.vertexCount = 0;
+        }
+        return *this;
+    }
+
+    // replaces the single level covering all indices with the levels built by ModelData
+    void setLods(vector<MeshLod> newLods)
+    {
+        if(newLods.empty())
+            return;
+        lods = std::move(newLods);
+        indexCount = lods[0].indexCount;
+    }
+
+    int lodCount() const
+    {
+        return (int)lods.size();
+    }
+
+    // frees the CPU copy of the vertices and indices; the GPU buffers and bounds stay
+    void releaseCpuData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
     }
 
-    // render the mesh
-    void Draw(Shader &shader) 
+    // the given level of detail, or the coarsest one if there are fewer
+    const MeshLod &getLod(int lod) const
     {
-        // bind appropriate textures
+        return lods[std::min(std::max(lod, 0), lodCount() - 1)];
+    }
+
+    // number of indices in the EBO, every level of detail included
+    unsigned int indexBufferCount() const
+    {
+        unsigned int count = 0;
+        for(const MeshLod &lod : lods)
+            count = std::max(count, lod.indexOffset + lod.indexCount);
+        return count;
+    }
+
+    unsigned int vertexBuffer() const { return VBO; }
+    unsigned int indexBuffer() const { return EBO; }
+
+    // deletes the VAO/VBO/EBO, e.g. once a MeshPack holds a copy of them; the mesh can then
+    // only be drawn through the pack
+    void releaseGpuBuffers()
+    {
+        freeBuffers();
+    }
+
+    // render the mesh, at the given level of detail or the coarsest one it has
+    void Draw(Shader &shader, int lod = 0)
+    {
+        if(!VAO)
+            return;
+        bindTextures(shader);
+
+        // draw mesh
+        GLStateCache::get().bindVertexArray(VAO);
+        const MeshLod &level = getLod(lod);
+        glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT, (void *)(level.indexOffset * sizeof(unsigned int)));
+
+        // always good practice to set everything back to defaults once configured.
+        GLStateCache::get().activeTexture(0);
+    }
+
+    // sets the samplers of shader to our textures and binds them
+    void bindTextures(Shader &shader)
+    {
+        GLStateCache &state = GLStateCache::get();
+        for(const TextureBinding &binding : getTextureBindings(shader))
+        {
+            // now set the sampler to the correct texture unit
+            glUniform1i(binding.location, binding.unit);
+            // and finally bind the texture, skipped when the unit already holds it
+            state.bindTexture(binding.unit, binding.texture);
+        }
+    }
+
+private:
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+
+    void freeBuffers()
+    {
+        // Safe cleanup only if GL context is still active
+        if(!VAO || !glfwGetCurrentContext())
+            return;
+        GLStateCache::get().forgetVertexArray(VAO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+    }
+
+    // sampler location and texture unit of one of our textures in a given shader program
+    struct TextureBinding {
+        GLint location;
+        unsigned int unit;
+        unsigned int texture;
+    };
+    // texture bindings per shader program, resolved the first time we're drawn with it
+    vector<pair<unsigned int, vector<TextureBinding>>> programBindings;
+
+    const vector<TextureBinding> &getTextureBindings(const Shader &shader)
+    {
+        for(const auto &program : programBindings)
+            if(program.first == shader.ID)
+                return program.second;
+
+        vector<TextureBinding> bindings;
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -79,68 +342,58 @@ public:
              else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to string
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // textures the shader doesn't sample are never bound
+            GLint location = shader.uniform(name + number).location;
+            if(location >= 0)
+                bindings.push_back({ location, i, textures[i].id });
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        programBindings.emplace_back(shader.ID, std::move(bindings));
+        return programBindings.back().second;
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexDataCount)
     {
+        indexCount = static_cast<unsigned int>(indexDataCount);
+        this->vertexCount = static_cast<unsigned int>(vertexCount);
+        lods.assign(1, MeshLod());
+        lods[0].indexCount = indexCount;
+        if(vertexCount > 0)
+        {
+            minBounds = maxBounds = vertexData[0].Position;
+            for(size_t i = 0; i < vertexCount; i++)
+            {
+                minBounds = glm::min(minBounds, vertexData[i].Position);
+                maxBounds = glm::max(maxBounds, vertexData[i].Position);
+            }
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLStateCache::get().bindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        // again translates to 3/2 floats which translates to a byte array. Compact formats are packed first.
+        const VertexLayout &layout = vertexLayout(format);
+        if(format == VertexFormat::Full)
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
+        else
+        {
+            vector<unsigned char> encoded = encodeVertices(format, vertexData, vertexCount);
+            glBufferData(GL_ARRAY_BUFFER, encoded.size(), encoded.data(), GL_STATIC_DRAW);
+        }
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexDataCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
-
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-        glBindVertexArray(0);
+        layout.apply();
+        GLStateCache::get().bindVertexArray(0);
     }
 };
 #endif
@@ -0,0 +1,484 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Level of detail for indexed triangle lists. Like mesh_optimize.h this never touches GL.
+//
+// simplifyMesh is a quadric error metric edge collapse (Garland and Heckbert) that only
+// moves vertices onto existing vertices, so the vertex buffer is shared by every level and
+// each level is just another index range. Vertices that share a position but not their
+// attributes (UV seams, hard normals) collapse together with their twin along the seam or
+// not at all; open borders only collapse along the border. Callers veto collapses that
+// would change attributes too much, e.g. between vertices skinned to different bones.
+//
+// selectLod picks the coarsest level whose estimated error, projected onto the screen, stays
+// under a pixel threshold, with hysteresis so a level doesn't flicker at the switching
+// distance. The error is the quadric estimate of simplifyMesh, not a bound: a level can stray
+// further from the full detail surface in places, so the threshold is a target, not a promise.
+
+struct MeshLod
+{
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    float error = 0.0f;     // object space error estimate from the collapse quadrics, see simplifyMesh
+};
+
+// how a camera sees levels of detail
+struct LodView
+{
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 0.0f;     // screen pixels of one unit at distance one, see makeLodView
+    float maxPixelError = 1.0f;
+    float hysteresis = 0.25f;       // coarser levels need to be this much below maxPixelError
+};
+
+inline LodView makeLodView(const glm::vec3 &cameraPosition, float fovY, float viewportHeight, float maxPixelError = 1.0f)
+{
+    LodView view;
+    view.cameraPosition = cameraPosition;
+    view.pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+    view.maxPixelError = maxPixelError;
+    return view;
+}
+
+// errors of the levels, finest first, and the level currently drawn; distance and scale
+// place the object, so errors project to error * scale / distance * view.pixelsPerUnit
+inline int selectLod(const float *errors, int levelCount, int current, float distance, float scale, const LodView &view)
+{
+    if (levelCount <= 1)
+        return 0;
+    float pixelsPerError = scale * view.pixelsPerUnit / std::max(distance, 1e-4f);
+    int target = 0, coarser = 0;
+    for (int level = 1; level < levelCount; level++)
+    {
+        float pixels = errors[level] * pixelsPerError;
+        if (pixels <= view.maxPixelError)
+            target = level;
+        if (pixels <= view.maxPixelError * (1.0f - view.hysteresis))
+            coarser = level;
+    }
+    // finer when the current level got too coarse, coarser only once clearly below the threshold
+    current = std::clamp(current, 0, levelCount - 1);
+    if (current > target)
+        return target;
+    return std::max(current, coarser);
+}
+
+// the same for an object drawn with modelMatrix, measured from its object space center
+inline int selectLod(const std::vector<float> &errors, int current, const glm::mat4 &modelMatrix, const glm::vec3 &center,
+                     const LodView &view)
+{
+    glm::vec3 worldCenter(modelMatrix * glm::vec4(center, 1.0f));
+    float scale = std::max(std::max(glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1]))),
+                           glm::length(glm::vec3(modelMatrix[2])));
+    return selectLod(errors.data(), (int)errors.size(), current, glm::distance(worldCenter, view.cameraPosition), scale, view);
+}
+
+// folds the levels of one mesh into the per level errors of the whole model
+inline void mergeLodErrors(std::vector<float> &errors, const std::vector<MeshLod> &lods)
+{
+    if (lods.empty())
+        return;
+    // a mesh with fewer levels draws its coarsest one for the levels it lacks
+    size_t levels = std::max(errors.size(), lods.size());
+    float last = errors.empty() ? 0.0f : errors.back();
+    errors.resize(levels, last);
+    for (size_t level = 0; level < levels; level++)
+        errors[level] = std::max(errors[level], lods[std::min(level, lods.size() - 1)].error);
+}
+
+namespace qem
+{
+    // symmetric 4x4 matrix of the summed plane equations, and the summed weight
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double weight = 0;
+
+        void addPlane(const glm::dvec3 &normal, double distance, double planeWeight)
+        {
+            a00 += planeWeight * normal.x * normal.x;
+            a01 += planeWeight * normal.x * normal.y;
+            a02 += planeWeight * normal.x * normal.z;
+            a03 += planeWeight * normal.x * distance;
+            a11 += planeWeight * normal.y * normal.y;
+            a12 += planeWeight * normal.y * normal.z;
+            a13 += planeWeight * normal.y * distance;
+            a22 += planeWeight * normal.z * normal.z;
+            a23 += planeWeight * normal.z * distance;
+            a33 += planeWeight * distance * distance;
+            weight += planeWeight;
+        }
+
+        void add(const Quadric &other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+            weight += other.weight;
+        }
+
+        // weighted mean squared distance of p to the planes
+        double error(const glm::dvec3 &p) const
+        {
+            double sum = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33 +
+                         2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + a03 * p.x + a13 * p.y + a23 * p.z);
+            return weight > 0.0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+    };
+
+    enum VertexKind : unsigned char
+    {
+        Manifold,   // interior vertex without a twin, collapses anywhere
+        Border,     // on an open border, collapses along it
+        Seam,       // one twin with other attributes, collapses along the seam with its twin
+        Locked
+    };
+
+    // open borders hold their shape much stronger than the surface
+    const double BORDER_WEIGHT = 10.0;
+
+    inline uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return (uint64_t)a << 32 | b;
+    }
+}
+
+// Simplifies the triangles in indices towards targetIndexCount, skipping collapses whose
+// error is above maxError, and returns the new index count; the remaining indices are
+// written to the front of indices. canCollapse(from, to) decides whether vertex from may be
+// replaced by vertex to. The error of a collapse is the square root of its quadric cost, the
+// area weighted mean squared distance of the new position to the planes around both
+// vertices, in object space units; resultError receives the largest one. That is an
+// estimate of how far the surface moved, not an upper bound on it.
+template <typename CanCollapse>
+size_t simplifyMesh(unsigned int *indices, size_t indexCount, const float *positions, size_t vertexCount, size_t stride,
+                    size_t targetIndexCount, float maxError, float *resultError, CanCollapse canCollapse)
+{
+    using namespace qem;
+    if (resultError)
+        *resultError = 0.0f;
+    indexCount -= indexCount % 3;
+    for (size_t i = 0; i < indexCount; i++)
+        if (indices[i] >= vertexCount)
+            return indexCount;
+    auto position = [&](unsigned int vertex) {
+        const float *p = (const float *)((const unsigned char *)positions + vertex * stride);
+        return glm::dvec3(p[0], p[1], p[2]);
+    };
+
+    // vertices with bitwise equal positions share one position id and form a ring of twins
+    std::vector<unsigned int> positionId(vertexCount), nextTwin(vertexCount);
+    {
+        struct PositionHash
+        {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                uint32_t bits[3];
+                std::memcpy(bits, &p, sizeof(bits));
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+        std::unordered_map<glm::vec3, unsigned int, PositionHash> firstAt;
+        firstAt.reserve(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            const float *p = (const float *)((const unsigned char *)positions + v * stride);
+            auto inserted = firstAt.emplace(glm::vec3(p[0], p[1], p[2]), v);
+            unsigned int first = inserted.first->second;
+            positionId[v] = first;
+            nextTwin[v] = v;
+            if (first != v)
+            {
+                nextTwin[v] = nextTwin[first];
+                nextTwin[first] = v;
+            }
+        }
+    }
+
+    // plane quadrics of the original triangles, accumulated per position
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        glm::dvec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double area = glm::length(normal);
+        if (area <= 0.0)
+            continue;
+        normal /= area;
+        Quadric plane;
+        plane.addPlane(normal, -glm::dot(normal, a), area * 0.5);
+        for (int k = 0; k < 3; k++)
+            quadrics[positionId[indices[i + k]]].add(plane);
+    }
+
+    std::vector<unsigned char> kind(vertexCount);
+    std::vector<unsigned int> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1), adjacency;
+    // directed edges as sorted keys, positionEdges keeps duplicates to count them
+    std::vector<uint64_t> attributeEdges, positionEdges, openPositionEdges;
+    std::unordered_set<uint64_t> borderQuadricsAdded;
+    auto hasEdge = [](const std::vector<uint64_t> &edges, uint64_t key) {
+        return std::binary_search(edges.begin(), edges.end(), key);
+    };
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+    };
+    std::vector<Collapse> collapses;
+    double worstError = 0.0;
+    double maxCost = (double)maxError * (double)maxError;
+
+    while (indexCount > targetIndexCount)
+    {
+        // edges of the current triangles, by vertex and by position
+        attributeEdges.clear();
+        positionEdges.clear();
+        attributeEdges.reserve(indexCount);
+        positionEdges.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+                attributeEdges.push_back(edgeKey(a, b));
+                positionEdges.push_back(edgeKey(positionId[a], positionId[b]));
+            }
+        std::sort(attributeEdges.begin(), attributeEdges.end());
+        attributeEdges.erase(std::unique(attributeEdges.begin(), attributeEdges.end()), attributeEdges.end());
+        std::sort(positionEdges.begin(), positionEdges.end());
+        auto attributeOpen = [&](unsigned int a, unsigned int b) {
+            return hasEdge(attributeEdges, edgeKey(a, b)) && !hasEdge(attributeEdges, edgeKey(b, a));
+        };
+
+        // classify the vertices; open borders also get quadrics that keep them in place
+        std::vector<unsigned int> openOut(vertexCount, 0), openIn(vertexCount, 0);
+        std::vector<unsigned int> positionOpen(vertexCount, 0);
+        std::vector<bool> complex(vertexCount, false);
+        openPositionEdges.clear();
+        for (size_t i = 0; i < positionEdges.size(); i++)
+        {
+            uint64_t edge = positionEdges[i];
+            if (i > 0 && positionEdges[i - 1] == edge)
+            {
+                complex[edge >> 32] = complex[(unsigned int)edge] = true; // non manifold
+                continue;
+            }
+            unsigned int a = (unsigned int)(edge >> 32), b = (unsigned int)edge;
+            if (!hasEdge(positionEdges, edgeKey(b, a)))
+            {
+                positionOpen[a]++;
+                positionOpen[b]++;
+                openPositionEdges.push_back(edge);
+            }
+        }
+        for (uint64_t edge : attributeEdges)
+        {
+            unsigned int a = (unsigned int)(edge >> 32), b = (unsigned int)edge;
+            if (!hasEdge(attributeEdges, edgeKey(b, a)))
+            {
+                openOut[a]++;
+                openIn[b]++;
+            }
+        }
+        for (unsigned int v = 0; v < vertexCount; v++)
+        {
+            unsigned int p = positionId[v];
+            unsigned int twins = 0;
+            for (unsigned int t = nextTwin[v]; t != v; t = nextTwin[t])
+                twins++;
+            if (complex[p])
+                kind[v] = Locked;
+            else if (twins == 0 && positionOpen[p] == 0)
+                kind[v] = Manifold;
+            else if (twins == 0 && positionOpen[p] == 2)
+                kind[v] = Border;
+            else if (twins == 1 && positionOpen[p] == 0 && openOut[v] == 1 && openIn[v] == 1)
+                kind[v] = Seam;
+            else
+                kind[v] = Locked;
+        }
+        for (size_t i = 0; i < indexCount; i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+                uint64_t key = edgeKey(positionId[a], positionId[b]);
+                if (!hasEdge(openPositionEdges, key) || !borderQuadricsAdded.insert(key).second)
+                    continue;
+                glm::dvec3 pa = position(a), pb = position(b), pc = position(indices[i + (k + 2) % 3]);
+                glm::dvec3 edge = pb - pa;
+                glm::dvec3 normal = glm::cross(edge, glm::cross(edge, pc - pa));
+                double length = glm::length(normal);
+                if (length <= 0.0)
+                    continue;
+                normal /= length;
+                Quadric plane;
+                plane.addPlane(normal, -glm::dot(normal, pa), glm::dot(edge, edge) * BORDER_WEIGHT);
+                quadrics[positionId[a]].add(plane);
+                quadrics[positionId[b]].add(plane);
+            }
+
+        // the twin of from's twin collapses onto the twin of to that shares a seam edge with it
+        auto seamPartner = [&](unsigned int from, unsigned int to, unsigned int &twinTo) {
+            unsigned int twinFrom = nextTwin[from];
+            for (unsigned int t = nextTwin[to]; t != to; t = nextTwin[t])
+                if (attributeOpen(twinFrom, t) || attributeOpen(t, twinFrom))
+                {
+                    twinTo = t;
+                    return true;
+                }
+            return false;
+        };
+        auto allowed = [&](unsigned int from, unsigned int to) {
+            unsigned int pFrom = positionId[from], pTo = positionId[to];
+            if (pFrom == pTo)
+                return false;
+            switch (kind[from])
+            {
+            case Manifold:
+                return true;
+            case Border:
+                return hasEdge(openPositionEdges, edgeKey(pFrom, pTo)) || hasEdge(openPositionEdges, edgeKey(pTo, pFrom));
+            case Seam:
+            {
+                unsigned int twinTo;
+                return (kind[to] == Seam || kind[to] == Locked) && (attributeOpen(from, to) || attributeOpen(to, from)) &&
+                       seamPartner(from, to, twinTo);
+            }
+            default:
+                return false;
+            }
+        };
+
+        // rank every possible collapse by the error of moving from onto to
+        collapses.clear();
+        for (size_t i = 0; i < indexCount; i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+                if (a > b && hasEdge(attributeEdges, edgeKey(b, a)))
+                    continue; // the triangle on the other side has this edge as well
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction ? b : a, to = direction ? a : b;
+                    if (!allowed(from, to))
+                        continue;
+                    Quadric q = quadrics[positionId[from]];
+                    q.add(quadrics[positionId[to]]);
+                    double cost = q.error(position(to));
+                    if (cost <= maxCost)
+                        collapses.push_back({ from, to, cost });
+                }
+            }
+        if (collapses.empty())
+            break;
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+        // triangles around every position, for the flip test
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (size_t i = 0; i < indexCount; i++)
+            adjacencyOffsets[positionId[indices[i]] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(indexCount);
+        {
+            std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i++)
+                adjacency[fill[positionId[indices[i]]]++] = (unsigned int)(i / 3);
+        }
+        auto flips = [&](unsigned int from, unsigned int to) {
+            unsigned int pFrom = positionId[from], pTo = positionId[to];
+            glm::dvec3 target = position(to);
+            for (unsigned int j = adjacencyOffsets[pFrom]; j < adjacencyOffsets[pFrom + 1]; j++)
+            {
+                const unsigned int *triangle = indices + adjacency[j] * 3;
+                glm::dvec3 corners[3];
+                bool collapsing = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    corners[k] = position(triangle[k]);
+                    collapsing = collapsing || positionId[triangle[k]] == pTo;
+                }
+                if (collapsing)
+                    continue; // this triangle goes away
+                glm::dvec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for (int k = 0; k < 3; k++)
+                    if (positionId[triangle[k]] == pFrom)
+                        corners[k] = target;
+                glm::dvec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+                    return true;
+            }
+            return false;
+        };
+
+        // take the cheapest collapses whose neighbourhoods don't overlap, about two triangles each
+        for (unsigned int v = 0; v < vertexCount; v++)
+            collapseTo[v] = v;
+        std::fill(touched.begin(), touched.end(), false);
+        size_t trianglesToRemove = (indexCount - targetIndexCount) / 3;
+        size_t removed = 0;
+        for (const Collapse &collapse : collapses)
+        {
+            if (removed >= trianglesToRemove)
+                break;
+            unsigned int pFrom = positionId[collapse.from], pTo = positionId[collapse.to];
+            if (touched[pFrom] || touched[pTo])
+                continue;
+            bool neighbourTouched = false;
+            for (unsigned int j = adjacencyOffsets[pFrom]; j < adjacencyOffsets[pFrom + 1] && !neighbourTouched; j++)
+                for (int k = 0; k < 3; k++)
+                    neighbourTouched = neighbourTouched || touched[positionId[indices[adjacency[j] * 3 + k]]];
+            if (neighbourTouched || flips(collapse.from, collapse.to))
+                continue;
+            if (!canCollapse(collapse.from, collapse.to))
+                continue;
+            unsigned int twinTo = collapse.to;
+            if (kind[collapse.from] == Seam)
+            {
+                if (!seamPartner(collapse.from, collapse.to, twinTo) || !canCollapse(nextTwin[collapse.from], twinTo))
+                    continue;
+                collapseTo[nextTwin[collapse.from]] = twinTo;
+            }
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[pTo].add(quadrics[pFrom]);
+            touched[pFrom] = touched[pTo] = true;
+            worstError = std::max(worstError, collapse.cost);
+            removed += 2;
+        }
+        if (removed == 0)
+            break;
+
+        // rewrite the triangles and drop the ones that collapsed
+        size_t written = 0;
+        for (size_t i = 0; i < indexCount; i += 3)
+        {
+            unsigned int a = collapseTo[indices[i]], b = collapseTo[indices[i + 1]], c = collapseTo[indices[i + 2]];
+            if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[c] == positionId[a])
+                continue;
+            indices[written++] = a;
+            indices[written++] = b;
+            indices[written++] = c;
+        }
+        indexCount = written;
+    }
+    if (resultError)
+        *resultError = (float)std::sqrt(worstError);
+    return indexCount;
+}
+#endif
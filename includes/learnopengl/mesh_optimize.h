@@ -0,0 +1,333 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Load time reordering of indexed triangle lists for the GPU. Works on plain index and
+// position arrays and never touches GL, so every step can be run and checked headless.
+//
+//   optimizeVertexCache  reorders triangles for the post-transform vertex cache (Forsyth)
+//   optimizeOverdraw     reorders the cache friendly runs so outward facing ones draw first
+//   optimizeVertexFetch  renumbers vertices in first use order for linear vertex fetch
+//
+// analyzeVertexCache measures a triangle order against a FIFO cache:
+//   ACMR  transformed vertices per triangle, 0.5 is ideal for a regular grid, 3 the worst
+//   ATVR  transformed vertices per vertex, 1 is ideal
+
+struct VertexCacheStats
+{
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+struct MeshOptimizeOptions
+{
+    bool vertexCache = true;
+    bool overdraw = true;
+    bool vertexFetch = true;
+    // simplified levels of detail generated after the full one, see mesh_lod.h
+    unsigned int lodLevels = 3;
+
+    // bake files record which steps ran, so changing the options rebakes
+    uint32_t flags() const
+    {
+        return (vertexCache ? 1u : 0u) | (overdraw ? 2u : 0u) | (vertexFetch ? 4u : 0u) | lodLevels << 8;
+    }
+};
+
+// FIFO cache size the stats are measured with, a common size for post-transform caches
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+inline VertexCacheStats analyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount,
+                                           unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+    // a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    size_t misses = 0, usedCount = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (vertex >= vertexCount)
+            continue;
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            usedCount++;
+        }
+        else if (misses - loadedAt[vertex] < cacheSize)
+            continue;
+        loadedAt[vertex] = ++misses;
+    }
+    stats.acmr = (float)misses / (float)(indexCount / 3);
+    stats.atvr = usedCount > 0 ? (float)misses / (float)usedCount : 0.0f;
+    return stats;
+}
+
+namespace forsyth
+{
+    // scoring from Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    inline float vertexScore(int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f; // nothing left to draw with this vertex
+        float score = 0.0f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+                score = LAST_TRIANGLE_SCORE; // the vertices of the triangle just drawn
+            else
+                score = std::pow(1.0f - (float)(cachePosition - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        // favour vertices with few triangles left so they can leave the cache for good
+        return score + VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+    }
+}
+
+// greedily emits the triangle whose vertices score highest for the simulated LRU cache
+inline void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || vertexCount == 0)
+        return;
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        if (indices[i] >= vertexCount)
+            return;
+
+    // per vertex list of the triangles using it
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        offsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] += offsets[v];
+    std::vector<unsigned int> remaining(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        remaining[v] = offsets[v + 1] - offsets[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = forsyth::vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    std::vector<unsigned int> cache, nextCache, evicted;
+    cache.reserve(forsyth::CACHE_SIZE + 3);
+    nextCache.reserve(forsyth::CACHE_SIZE + 3);
+    size_t scanFrom = 0; // triangles before this are all emitted
+
+    long best = -1;
+    for (size_t t = 0; t < triangleCount; t++)
+        if (best < 0 || triangleScores[t] > triangleScores[best])
+            best = (long)t;
+
+    while (best >= 0)
+    {
+        const unsigned int *triangle = indices + best * 3;
+        emitted[best] = true;
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // the new triangle's vertices go to the front of the LRU cache
+        nextCache.assign(triangle, triangle + 3);
+        for (unsigned int vertex : cache)
+            if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+                nextCache.push_back(vertex);
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = triangle[k];
+            unsigned int *list = adjacency.data() + offsets[vertex];
+            unsigned int *end = list + remaining[vertex];
+            std::remove(list, end, (unsigned int)best);
+            remaining[vertex]--;
+        }
+        evicted.clear();
+        for (size_t i = forsyth::CACHE_SIZE; i < nextCache.size(); i++)
+        {
+            cachePosition[nextCache[i]] = -1;
+            evicted.push_back(nextCache[i]);
+        }
+        if (nextCache.size() > (size_t)forsyth::CACHE_SIZE)
+            nextCache.resize(forsyth::CACHE_SIZE);
+        std::swap(cache, nextCache);
+        for (size_t i = 0; i < cache.size(); i++)
+            cachePosition[cache[i]] = (int)i;
+
+        // rescore the vertices that moved and the triangles touching them, then pick the best
+        // triangle around the cache
+        evicted.insert(evicted.end(), cache.begin(), cache.end());
+        for (unsigned int vertex : evicted)
+        {
+            float score = forsyth::vertexScore(cachePosition[vertex], remaining[vertex]);
+            float delta = score - vertexScores[vertex];
+            vertexScores[vertex] = score;
+            const unsigned int *list = adjacency.data() + offsets[vertex];
+            for (unsigned int i = 0; i < remaining[vertex]; i++)
+                triangleScores[list[i]] += delta;
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int vertex : cache)
+        {
+            const unsigned int *list = adjacency.data() + offsets[vertex];
+            for (unsigned int i = 0; i < remaining[vertex]; i++)
+                if (triangleScores[list[i]] > bestScore)
+                {
+                    bestScore = triangleScores[list[i]];
+                    best = (long)list[i];
+                }
+        }
+        // nothing in the cache has triangles left, continue with the next unconnected piece
+        if (best < 0)
+        {
+            while (scanFrom < triangleCount && emitted[scanFrom])
+                scanFrom++;
+            if (scanFrom < triangleCount)
+                best = (long)scanFrom;
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Splits the triangle order into runs that start with a cold cache (all three vertices
+// missing in the FIFO), which can be shuffled without changing ACMR much, then draws runs
+// that face away from the mesh center first (Sander et al., "Fast triangle reordering for
+// vertex locality and reduced overdraw"). Run it after optimizeVertexCache. positions
+// points at the first vertex position, stride is the distance between vertices in bytes.
+inline void optimizeOverdraw(unsigned int *indices, size_t indexCount, const float *positions, size_t vertexCount,
+                             size_t stride, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2 || vertexCount == 0)
+        return;
+    for (size_t i = 0; i < triangleCount * 3; i++)
+        if (indices[i] >= vertexCount)
+            return;
+    auto position = [&](unsigned int vertex) {
+        const float *p = (const float *)((const unsigned char *)positions + vertex * stride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // runs begin where a triangle misses the cache on all three vertices
+    std::vector<size_t> runStarts;
+    std::vector<size_t> loadedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int vertex = indices[t * 3 + k];
+            if (loadedAt[vertex] == 0 || misses - loadedAt[vertex] >= cacheSize)
+            {
+                loadedAt[vertex] = ++misses;
+                triangleMisses++;
+            }
+        }
+        if (t == 0 || triangleMisses == 3)
+            runStarts.push_back(t);
+    }
+    runStarts.push_back(triangleCount);
+    if (runStarts.size() <= 2)
+        return;
+
+    // area weighted centroid of the whole mesh and of every run, and each run's facing
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    size_t runCount = runStarts.size() - 1;
+    std::vector<glm::vec3> runCentroids(runCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> runNormals(runCount, glm::vec3(0.0f));
+    for (size_t r = 0; r < runCount; r++)
+    {
+        float runArea = 0.0f;
+        for (size_t t = runStarts[r]; t < runStarts[r + 1]; t++)
+        {
+            glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), c = position(indices[t * 3 + 2]);
+            glm::vec3 normal = glm::cross(b - a, c - a); // length is twice the area
+            float area = glm::length(normal);
+            runCentroids[r] += (a + b + c) * (area / 3.0f);
+            runNormals[r] += normal;
+            runArea += area;
+        }
+        meshCentroid += runCentroids[r];
+        meshArea += runArea;
+        runCentroids[r] = runArea > 0.0f ? runCentroids[r] / runArea : position(indices[runStarts[r] * 3]);
+    }
+    meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : glm::vec3(0.0f);
+
+    std::vector<float> sortKeys(runCount);
+    for (size_t r = 0; r < runCount; r++)
+    {
+        float length = glm::length(runNormals[r]);
+        sortKeys[r] = length > 0.0f ? glm::dot(runCentroids[r] - meshCentroid, runNormals[r] / length) : 0.0f;
+    }
+    std::vector<size_t> order(runCount);
+    for (size_t r = 0; r < runCount; r++)
+        order[r] = r;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(triangleCount * 3);
+    for (size_t r : order)
+        output.insert(output.end(), indices + runStarts[r] * 3, indices + runStarts[r + 1] * 3);
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// renumbers the vertices in the order the indices first use them and rewrites the indices;
+// returns the old index of every new vertex, unused vertices dropped, for remapVertices
+inline std::vector<unsigned int> optimizeVertexFetch(unsigned int *indices, size_t indexCount, size_t vertexCount)
+{
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> newIndex(vertexCount, unassigned);
+    std::vector<unsigned int> oldIndex;
+    oldIndex.reserve(vertexCount);
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        unsigned int vertex = indices[i];
+        if (vertex >= vertexCount)
+            continue;
+        if (newIndex[vertex] == unassigned)
+        {
+            newIndex[vertex] = (unsigned int)oldIndex.size();
+            oldIndex.push_back(vertex);
+        }
+        indices[i] = newIndex[vertex];
+    }
+    return oldIndex;
+}
+
+template <typename V>
+std::vector<V> remapVertices(const V *vertices, const std::vector<unsigned int> &oldIndex)
+{
+    std::vector<V> remapped;
+    remapped.reserve(oldIndex.size());
+    for (unsigned int vertex : oldIndex)
+        remapped.push_back(vertices[vertex]);
+    return remapped;
+}
+#endif
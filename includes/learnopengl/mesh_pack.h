@@ -0,0 +1,160 @@
+#ifndef MESH_PACK_H
+#define MESH_PACK_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <vector>
+
+// the meshes of one model copied into a single VBO/EBO behind one VAO. Every mesh keeps its
+// own indices and is drawn with glDrawElementsBaseVertex from its range, so drawing the
+// whole model binds one VAO instead of one per mesh. Owns its GL objects, move only.
+class MeshPack
+{
+public:
+    // where a mesh landed in the shared buffers
+    struct Range {
+        GLint baseVertex;       // added to every index of the mesh
+        GLuint firstIndex;      // of the mesh's first level of detail
+    };
+    vector<Range> ranges;
+
+    MeshPack() = default;
+    MeshPack(const MeshPack &) = delete;
+    MeshPack &operator=(const MeshPack &) = delete;
+
+    MeshPack(MeshPack &&other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MeshPack &operator=(MeshPack &&other) noexcept
+    {
+        if(this != &other)
+        {
+            freeBuffers();
+            ranges = std::move(other.ranges);
+            VAO = other.VAO;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            other.VAO = other.VBO = other.EBO = 0;
+        }
+        return *this;
+    }
+
+    ~MeshPack()
+    {
+        freeBuffers();
+    }
+
+    bool isBuilt() const
+    {
+        return VAO != 0;
+    }
+
+    // copies the buffers of meshes, which all have to use the same vertex format, on the GPU
+    // and then deletes the per mesh buffers. Works whether or not the meshes kept their CPU data.
+    bool build(vector<Mesh> &meshes)
+    {
+        freeBuffers();
+        ranges.clear();
+        if(meshes.empty())
+            return false;
+        VertexFormat format = meshes[0].format;
+        GLsizeiptr vertexBytes = 0, indexBytes = 0;
+        for(const Mesh &mesh : meshes)
+        {
+            if(mesh.format != format || !mesh.vertexBuffer())
+            {
+                ranges.clear();
+                return false;
+            }
+            Range range;
+            range.baseVertex = (GLint)(vertexBytes / vertexLayout(format).stride);
+            range.firstIndex = (GLuint)(indexBytes / sizeof(unsigned int));
+            ranges.push_back(range);
+            vertexBytes += (GLsizeiptr)mesh.vertexCount * vertexLayout(format).stride;
+            indexBytes += (GLsizeiptr)mesh.indexBufferCount() * sizeof(unsigned int);
+        }
+
+        // copy through the copy targets, so no VAO picks up the element buffers on the way
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+        for(size_t i = 0; i < meshes.size(); i++)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].vertexBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                                (GLintptr)ranges[i].baseVertex * vertexLayout(format).stride,
+                                (GLsizeiptr)meshes[i].vertexCount * vertexLayout(format).stride);
+        }
+        glGenBuffers(1, &EBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+        for(size_t i = 0; i < meshes.size(); i++)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, meshes[i].indexBuffer());
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)ranges[i].firstIndex * sizeof(unsigned int),
+                                (GLsizeiptr)meshes[i].indexBufferCount() * sizeof(unsigned int));
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glGenVertexArrays(1, &VAO);
+        GLStateCache::get().bindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        vertexLayout(format).apply();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        GLStateCache::get().bindVertexArray(0);
+
+        for(Mesh &mesh : meshes)
+            mesh.releaseGpuBuffers();
+        return true;
+    }
+
+    // draws meshes, the ones this pack was built from, at a level of detail
+    void Draw(Shader &shader, vector<Mesh> &meshes, int lod = 0)
+    {
+        drawRanges(VAO, shader, meshes, lod);
+    }
+
+    // the same from another vertex array that uses this pack's index buffer and vertex
+    // numbering, e.g. the skinned copy of the vertices made by ComputeSkinning
+    void drawRanges(unsigned int vertexArray, Shader &shader, vector<Mesh> &meshes, int lod = 0)
+    {
+        GLStateCache &state = GLStateCache::get();
+        state.bindVertexArray(vertexArray);
+        for(size_t i = 0; i < meshes.size() && i < ranges.size(); i++)
+        {
+            meshes[i].bindTextures(shader);
+            const MeshLod &level = meshes[i].getLod(lod);
+            glDrawElementsBaseVertex(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+                                     (void *)((size_t)(ranges[i].firstIndex + level.indexOffset) * sizeof(unsigned int)),
+                                     ranges[i].baseVertex);
+        }
+        state.activeTexture(0);
+    }
+
+    unsigned int vertexArray() const { return VAO; }
+    unsigned int vertexBuffer() const { return VBO; }
+    unsigned int indexBuffer() const { return EBO; }
+
+private:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+    void freeBuffers()
+    {
+        if(!VAO || !glfwGetCurrentContext())
+            return;
+        GLStateCache::get().forgetVertexArray(VAO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteVertexArrays(1, &VAO);
+        VAO = VBO = EBO = 0;
+    }
+};
+#endif
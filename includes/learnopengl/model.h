@@ -11,9 +11,17 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_pack.h>
+#include <learnopengl/model_data.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_batch.h>
+#include <learnopengl/texture_cache.h>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <thread>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -27,46 +35,258 @@ class Model
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// the model's textures; shared with other models through TextureCache, so each file is only loaded once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    bool keepCpuData;   // when false, meshes drop their vertices/indices after upload and keep only bounds
+    vector<float> lodErrors;    // per level of detail the largest error of any mesh, see mesh_lod.h
+    MeshPack pack;              // the shared buffers after packMeshes()
+    VertexFormat vertexFormat;  // layout of the vertex buffers, see vertex_layout.h
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, bool keepCpuData = true, VertexFormat vertexFormat = VertexFormat::Full)
+        : gammaCorrection(gamma), keepCpuData(keepCpuData), vertexFormat(vertexFormat)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // starts loading the model on a background thread and returns right away. Call streamIn()
+    // once per frame to upload what has been parsed; until then the model draws nothing.
+    static Model loadAsync(string const &path, bool gamma = false, bool keepCpuData = true,
+                           VertexFormat vertexFormat = VertexFormat::Full)
     {
+        Model model;
+        model.gammaCorrection = gamma;
+        model.keepCpuData = keepCpuData;
+        model.vertexFormat = vertexFormat;
+        model.directory = path.substr(0, path.find_last_of('/'));
+        model.loading.reset(new AsyncLoad());
+        AsyncLoad *load = model.loading.get();
+        string directory = model.directory;
+        TextureReadOptions options = TextureBatch::readOptions();
+        load->worker = std::thread([load, path, directory, options]()
+        {
+            load->ok = parseModel(path, load->data);
+            // textures another model already loaded are taken from the cache instead
+            vector<string> filenames;
+            vector<bool> normalMaps;
+            for(const Texture &texture : load->data.textures)
+            {
+                string filename = directory + '/' + texture.path;
+                filenames.push_back(TextureCache::get().contains(filename) ? string() : filename);
+                normalMaps.push_back(texture.type == "texture_normal");
+            }
+            load->images = readTextures(filenames, normalMaps, options);
+            load->parsed = true;
+        });
+        return model;
+    }
+
+    // uploads textures and meshes of an asynchronous load until budgetMs is spent, at least one
+    // item per call. Returns true once the model is complete; always true for synchronous loads.
+    bool streamIn(double budgetMs = 2.0)
+    {
+        if(!loading)
+            return true;
+        if(!loading->parsed)
+            return false;
+        auto start = chrono::steady_clock::now();
+        auto spent = [&]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count(); };
+
+        AsyncLoad &load = *loading;
+        if(load.worker.joinable())
+        {
+            load.worker.join();
+            if(load.ok)
+                glGenBuffers(1, &load.pbo);
+            meshes.reserve(load.data.meshes.size());
+        }
+        while(load.ok && load.nextTexture < load.data.textures.size())
+        {
+            Texture &texture = load.data.textures[load.nextTexture];
+            DecodedImage &image = load.images[load.nextTexture];
+            string filename = directory + '/' + texture.path;
+            texture.id = TextureCache::get().acquire(filename);
+            if(!texture.id)
+            {
+                // evicted since the worker checked: decode it here after all
+                if(!image.loaded())
+                    image = readTexture(filename, texture.type == "texture_normal", TextureBatch::readOptions());
+                glGenTextures(1, &texture.id);
+                TextureCache::get().insert(filename, texture.id);
+                if(image.loaded())
+                {
+                    uploadImage(texture.id, image, load.pbo);
+                    TextureCache::get().setBytes(texture.id, textureBytes(image));
+                }
+                else
+                    cout << "Texture failed to load at path: " << texture.path << endl;
+            }
+            stbi_image_free(image.data);
+            image.data = nullptr;
+            textureReferences.add(texture.id);
+            textures_loaded.push_back(texture);
+            load.nextTexture++;
+            if(spent() >= budgetMs)
+                return false;
+        }
+        while(load.ok && load.nextMesh < load.data.meshes.size())
+        {
+            buildMesh(load.data, load.data.meshes[load.nextMesh++]);
+            if(spent() >= budgetMs)
+                return false;
+        }
+        loading.reset();
+        return true;
+    }
+
+    // false while an asynchronous load is still streaming in
+    bool isLoaded() const
+    {
+        return !loading;
+    }
+
+    // draws the model, and thus all its meshes, at a level of detail from selectLod
+    void Draw(Shader &shader, int lod = 0)
+    {
+        if(pack.isBuilt())
+        {
+            pack.Draw(shader, meshes, lod);
+            return;
+        }
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, lod);
+    }
+
+    // moves all meshes into one shared vertex and index buffer, see MeshPack, so Draw binds
+    // a single VAO. Call once the model is loaded; false if it couldn't be packed.
+    bool packMeshes()
+    {
+        return pack.build(meshes);
+    }
+
+    // level of detail to draw the model with at modelMatrix. Pass the level drawn last time
+    // as current, kept per instance, so the choice has hysteresis.
+    int selectLod(const glm::mat4 &modelMatrix, const LodView &view, int current = 0) const
+    {
+        if(meshes.empty())
+            return 0;
+        glm::vec3 minBounds = meshes[0].minBounds, maxBounds = meshes[0].maxBounds;
+        for(const Mesh &mesh : meshes)
+        {
+            minBounds = glm::min(minBounds, mesh.minBounds);
+            maxBounds = glm::max(maxBounds, mesh.maxBounds);
+        }
+        return ::selectLod(lodErrors, current, modelMatrix, (minBounds + maxBounds) * 0.5f, view);
     }
     
 private:
+    // state shared with the background thread of loadAsync; heap allocated so the Model can be moved
+    struct AsyncLoad {
+        std::thread worker;
+        std::atomic<bool> parsed{false};
+        bool ok = false;
+        ModelData data;
+        vector<DecodedImage> images;
+        size_t nextTexture = 0;
+        size_t nextMesh = 0;
+        unsigned int pbo = 0;
+
+        ~AsyncLoad()
+        {
+            if(worker.joinable())
+                worker.join();
+            for(DecodedImage &image : images)
+                stbi_image_free(image.data);
+            if(pbo && glfwGetCurrentContext())
+                glDeleteBuffers(1, &pbo);
+        }
+    };
+    std::unique_ptr<AsyncLoad> loading;
+
+    static constexpr char BAKE_MAGIC[4] = { 'L', 'M', 'D', 'L' };
+
+    Model() : gammaCorrection(false), keepCpuData(true), vertexFormat(VertexFormat::Full)
+    {
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
-        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
+        ModelData data;
+        if(!parseModel(path, data))
+            return;
+
+        // textures other models haven't loaded yet decode in parallel while the meshes are built
+        TextureCache &cache = TextureCache::get();
+        for(Texture &texture : data.textures)
+        {
+            string filename = directory + '/' + texture.path;
+            texture.id = cache.acquire(filename);
+            if(!texture.id)
+            {
+                texture.id = textureBatch.add(filename, texture.type == "texture_normal");
+                cache.insert(filename, texture.id);
+            }
+            textureReferences.add(texture.id);
+            textures_loaded.push_back(texture);
+        }
+        meshes.reserve(data.meshes.size());
+        for(MeshData &mesh : data.meshes)
+            buildMesh(data, mesh);
+        textureBatch.finish();
+    }
+
+    // CPU half of loading, safe to run on any thread: fills data from the bake next to the
+    // model, or through Assimp, baking the result for the next run
+    static bool parseModel(string const &path, ModelData &data)
+    {
+        auto start = chrono::steady_clock::now();
+        string bakePath = path + ".model.bake";
+        bool fromBake = data.loadBake(bakePath, BAKE_MAGIC, path, false);
+        if(!fromBake)
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return false;
+            }
+            // process ASSIMP's root node recursively
+            data.meshes.reserve(scene->mNumMeshes);
+            processNode(scene->mRootNode, scene, data);
+            data.optimizeMeshes();
+            if(!data.saveBake(bakePath, BAKE_MAGIC, path, false))
+                cout << "MODEL::BAKE failed to write " << bakePath << endl;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "MODEL::LOAD " << path << (fromBake ? " from bake in " : " through Assimp in ") << ms << " ms" << endl;
+        data.printCacheStats(path);
+        return true;
+    }
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+    // GL half of loading: creates the buffers of one mesh, its textures must have ids by now
+    void buildMesh(const ModelData &data, MeshData &mesh)
+    {
+        vector<Texture> textures;
+        for(uint32_t ref : mesh.textureRefs)
+            textures.push_back(data.textures[ref]);
+        if(mesh.vertexCount > 0 && mesh.vertices == mesh.ownedVertices.data())
+            meshes.emplace_back(std::move(mesh.ownedVertices), std::move(mesh.ownedIndices), std::move(textures), keepCpuData, vertexFormat);
+        else
+            meshes.emplace_back(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, std::move(textures), keepCpuData, vertexFormat);
+        meshes.back().setLods(mesh.lods);
+        mergeLodErrors(lodErrors, mesh.lods);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -74,22 +294,22 @@ private:
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene, data));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, ModelData &data)
     {
         // data to fill
+        MeshData meshData;
         vector<Vertex> vertices;
         vector<unsigned int> indices;
-        vector<Texture> textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -152,54 +372,36 @@ private:
         // normal: texture_normalN
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data, meshData.textureRefs);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data, meshData.textureRefs);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data, meshData.textureRefs);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data, meshData.textureRefs);
         
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data
+        meshData.own(std::move(vertices), std::move(indices));
+        return meshData;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and adds the ones not seen before to the
+    // model's texture table. The table indices of the textures are appended to refs.
+    static void loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, ModelData &data, vector<uint32_t> &refs)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
-            }
+            // a texture with the same filepath is only loaded once for the entire model
+            refs.push_back(data.addTexture(typeName, str.C_Str()));
         }
-        return textures;
     }
+
+    // textures found while loading, decoded in parallel and uploaded at the end of loadModel
+    TextureBatch textureBatch;
+    // our references on the shared textures in TextureCache
+    TextureReferences textureReferences;
 };
 
 
@@ -211,34 +413,12 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
+    DecodedImage image = decodeImage(filename);
+    if (image.data)
+        uploadImage(textureID, image);
     else
-    {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    stbi_image_free(image.data);
 
     return textureID;
 }
@@ -0,0 +1,323 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include <learnopengl/animdata.h>
+#include <learnopengl/baked_asset.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_lod.h>
+#include <learnopengl/mesh_optimize.h>
+
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// CPU side of one mesh. Building it never touches GL, so it can be done on any thread.
+struct MeshData {
+    // point into ownedVertices/ownedIndices, or straight into the mapped bake they came from
+    const Vertex *vertices = nullptr;
+    size_t vertexCount = 0;
+    const unsigned int *indices = nullptr;
+    size_t indexCount = 0;
+    // indices into ModelData::textures
+    vector<uint32_t> textureRefs;
+    // index ranges of the levels of detail, finest first; empty means one level with all indices
+    vector<MeshLod> lods;
+    // vertex cache efficiency of the index order from the file and after optimizeMeshes
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+
+    vector<Vertex> ownedVertices;
+    vector<unsigned int> ownedIndices;
+
+    void own(vector<Vertex> newVertices, vector<unsigned int> newIndices)
+    {
+        ownedVertices = std::move(newVertices);
+        ownedIndices = std::move(newIndices);
+        vertices = ownedVertices.data();
+        vertexCount = ownedVertices.size();
+        indices = ownedIndices.data();
+        indexCount = ownedIndices.size();
+    }
+};
+
+// everything a Model is made of before any GL object exists: the meshes, the texture table
+// and, for skinned models, the bone table. Filled by Assimp or from a bake.
+struct ModelData {
+    vector<MeshData> meshes;
+    vector<Texture> textures;   // type and path, ids are only assigned on upload
+    std::map<string, BoneInfo> boneInfoMap;
+    int boneCounter = 0;
+    // keeps the bake mapped while meshes point into it
+    std::unique_ptr<MappedFile> bakeFile;
+
+    // reordering applied to meshes coming from Assimp; the result is baked with the model
+    static inline MeshOptimizeOptions optimizeOptions;
+    // largest share of bone weight a level of detail may move between two vertices
+    static constexpr float MAX_LOD_WEIGHT_CHANGE = 0.25f;
+
+    // index of the texture with this path in the table, added if it isn't there yet
+    uint32_t addTexture(const string &type, const string &path)
+    {
+        for(uint32_t i = 0; i < textures.size(); i++)
+            if(textures[i].path == path)
+                return i;
+        Texture texture;
+        texture.id = 0;
+        texture.type = type;
+        texture.path = path;
+        textures.push_back(texture);
+        return (uint32_t)textures.size() - 1;
+    }
+
+    // reorders the indices and vertices of every mesh for the GPU caches, see mesh_optimize.h,
+    // then appends the simplified levels of detail to the indices. Only meshes that own their
+    // data are touched, baked ones were optimized before baking.
+    void optimizeMeshes()
+    {
+        for(MeshData &mesh : meshes)
+        {
+            if(mesh.vertexCount == 0 || mesh.vertices != mesh.ownedVertices.data())
+                continue;
+            vector<unsigned int> &indices = mesh.ownedIndices;
+            mesh.cacheBefore = analyzeVertexCache(indices.data(), indices.size(), mesh.ownedVertices.size());
+            if(optimizeOptions.vertexCache)
+                optimizeVertexCache(indices.data(), indices.size(), mesh.ownedVertices.size());
+            if(optimizeOptions.overdraw)
+                optimizeOverdraw(indices.data(), indices.size(), &mesh.ownedVertices[0].Position.x, mesh.ownedVertices.size(), sizeof(Vertex));
+            vector<Vertex> vertices = std::move(mesh.ownedVertices);
+            if(optimizeOptions.vertexFetch)
+                vertices = remapVertices(vertices.data(), optimizeVertexFetch(indices.data(), indices.size(), vertices.size()));
+            mesh.cacheAfter = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+            mesh.lods = buildLods(vertices, indices);
+            mesh.own(std::move(vertices), std::move(indices));
+        }
+    }
+
+    // Halves the triangle count per level, each level simplified from the one before, and
+    // appends the levels to indices. Stops early when a level would save less than 15%, e.g.
+    // on meshes that are mostly seams and borders. Vertices only collapse onto vertices with
+    // similar bone weights, so the levels skin like the full mesh.
+    static vector<MeshLod> buildLods(const vector<Vertex> &vertices, vector<unsigned int> &indices)
+    {
+        vector<MeshLod> lods(1);
+        lods[0].indexCount = (uint32_t)indices.size();
+        if(optimizeOptions.lodLevels == 0 || indices.size() < 3 * 64)
+            return lods;
+        glm::vec3 minBounds = vertices[0].Position, maxBounds = vertices[0].Position;
+        for(const Vertex &vertex : vertices)
+        {
+            minBounds = glm::min(minBounds, vertex.Position);
+            maxBounds = glm::max(maxBounds, vertex.Position);
+        }
+        // no collapse may have an estimated error above 5% of the mesh size
+        float maxError = 0.05f * glm::length(maxBounds - minBounds);
+        auto similarWeights = [&](unsigned int from, unsigned int to) {
+            return boneWeightDistance(vertices[from], vertices[to]) <= MAX_LOD_WEIGHT_CHANGE;
+        };
+
+        vector<unsigned int> level(indices);
+        float error = 0.0f;
+        for(unsigned int l = 1; l <= optimizeOptions.lodLevels; l++)
+        {
+            size_t target = (level.size() / 2) / 3 * 3;
+            float levelError = 0.0f;
+            size_t count = simplifyMesh(level.data(), level.size(), &vertices[0].Position.x, vertices.size(), sizeof(Vertex),
+                                        target, maxError, &levelError, similarWeights);
+            if(count == 0 || count > level.size() * 85 / 100)
+                break;
+            level.resize(count);
+            // estimates of consecutive levels add up against the full mesh
+            error += levelError;
+            if(optimizeOptions.vertexCache)
+                optimizeVertexCache(level.data(), level.size(), vertices.size());
+            MeshLod lod;
+            lod.indexOffset = (uint32_t)indices.size();
+            lod.indexCount = (uint32_t)level.size();
+            lod.error = error;
+            lods.push_back(lod);
+            indices.insert(indices.end(), level.begin(), level.end());
+        }
+        return lods;
+    }
+
+    // how much bone weight moves when one vertex takes the other's influences, 0 to 1
+    static float boneWeightDistance(const Vertex &a, const Vertex &b)
+    {
+        float moved = 0.0f;
+        for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            if(a.m_BoneIDs[i] < 0)
+                continue;
+            float weight = a.m_Weights[i];
+            for(int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                if(b.m_BoneIDs[j] == a.m_BoneIDs[i])
+                    weight -= b.m_Weights[j];
+            moved += std::fabs(weight);
+        }
+        for(int j = 0; j < MAX_BONE_INFLUENCE; j++)
+        {
+            if(b.m_BoneIDs[j] < 0)
+                continue;
+            bool shared = false;
+            for(int i = 0; i < MAX_BONE_INFLUENCE; i++)
+                shared = shared || a.m_BoneIDs[i] == b.m_BoneIDs[j];
+            if(!shared)
+                moved += b.m_Weights[j];
+        }
+        return moved * 0.5f;
+    }
+
+    // one ACMR/ATVR line per mesh and the triangle weighted totals, measured on the full detail level
+    void printCacheStats(const string &path) const
+    {
+        double triangles = 0.0, acmrBefore = 0.0, acmrAfter = 0.0;
+        for(size_t i = 0; i < meshes.size(); i++)
+        {
+            const MeshData &mesh = meshes[i];
+            size_t fullTriangles = (mesh.lods.empty() ? mesh.indexCount : mesh.lods[0].indexCount) / 3;
+            cout << "MODEL::CACHE " << path << " mesh " << i << ": ACMR " << mesh.cacheBefore.acmr << " -> " << mesh.cacheAfter.acmr
+                 << ", ATVR " << mesh.cacheBefore.atvr << " -> " << mesh.cacheAfter.atvr << ", LOD triangles";
+            for(const MeshLod &lod : mesh.lods)
+                cout << " " << lod.indexCount / 3;
+            cout << endl;
+            triangles += fullTriangles;
+            acmrBefore += mesh.cacheBefore.acmr * fullTriangles;
+            acmrAfter += mesh.cacheAfter.acmr * fullTriangles;
+        }
+        if(triangles > 0.0)
+            cout << "MODEL::CACHE " << path << " total: ACMR " << acmrBefore / triangles << " -> " << acmrAfter / triangles << endl;
+    }
+
+    // baked layout after the header: uint32 sizeof(Vertex), uint32 optimize flags, uint32 mesh
+    // count, per mesh the vertex cache stats and the vertex, index, texture table index and
+    // level of detail arrays, then the texture table as (type, path)
+    // pairs and, when withBones is set, the bone table as (name, id, offset) entries
+    // followed by the bone counter
+    bool saveBake(const string &bakePath, const char magic[4], const string &sourcePath, bool withBones) const
+    {
+        BakeWriter bake;
+        if(!beginBake(bake, magic, sourcePath))
+            return false;
+        bake.write((uint32_t)sizeof(Vertex));
+        bake.write(optimizeOptions.flags());
+        bake.write((uint32_t)meshes.size());
+        for(const MeshData &mesh : meshes)
+        {
+            bake.write(mesh.cacheBefore);
+            bake.write(mesh.cacheAfter);
+            bake.writeArray(mesh.vertices, (uint32_t)mesh.vertexCount);
+            bake.writeArray(mesh.indices, (uint32_t)mesh.indexCount);
+            bake.writeArray(mesh.textureRefs);
+            bake.writeArray(mesh.lods);
+        }
+        bake.write((uint32_t)textures.size());
+        for(const Texture &texture : textures)
+        {
+            bake.writeString(texture.type);
+            bake.writeString(texture.path);
+        }
+        if(withBones)
+        {
+            bake.write((uint32_t)boneInfoMap.size());
+            for(const auto &bone : boneInfoMap)
+            {
+                bake.writeString(bone.first);
+                bake.write(bone.second.id);
+                bake.write(bone.second.offset);
+            }
+            bake.write(boneCounter);
+        }
+        return bake.save(bakePath);
+    }
+
+    // maps an up to date bake and points the meshes into it; false if it is missing, stale
+    // or damaged, in which case nothing is changed
+    bool loadBake(const string &bakePath, const char magic[4], const string &sourcePath, bool withBones)
+    {
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        if(!openBake(*file, bakePath, magic, sourcePath))
+            return false;
+        BakeReader reader = bakePayload(*file);
+
+        uint32_t vertexSize = 0, optimizeFlags = 0, meshCount = 0;
+        reader.read(vertexSize);
+        reader.read(optimizeFlags);
+        reader.read(meshCount);
+        if(!reader.good() || vertexSize != sizeof(Vertex) || optimizeFlags != optimizeOptions.flags())
+            return false;
+        vector<MeshData> bakedMeshes;
+        for(uint32_t m = 0; reader.good() && m < meshCount; m++)
+        {
+            MeshData mesh;
+            uint32_t vertexCount = 0, indexCount = 0, textureCount = 0;
+            reader.read(mesh.cacheBefore);
+            reader.read(mesh.cacheAfter);
+            mesh.vertices = reader.readArray<Vertex>(vertexCount);
+            mesh.indices = reader.readArray<unsigned int>(indexCount);
+            const uint32_t *textureRefs = reader.readArray<uint32_t>(textureCount);
+            uint32_t lodCount = 0;
+            const MeshLod *lods = reader.readArray<MeshLod>(lodCount);
+            if(!reader.good())
+                return false;
+            mesh.lods.assign(lods, lods + lodCount);
+            for(const MeshLod &lod : mesh.lods)
+                if((size_t)lod.indexOffset + lod.indexCount > indexCount)
+                    return false;
+            for(uint32_t i = 0; i < indexCount; i++)
+                if(mesh.indices[i] >= vertexCount)
+                    return false;
+            mesh.vertexCount = vertexCount;
+            mesh.indexCount = indexCount;
+            mesh.textureRefs.assign(textureRefs, textureRefs + textureCount);
+            bakedMeshes.push_back(std::move(mesh));
+        }
+        uint32_t textureCount = 0;
+        reader.read(textureCount);
+        // every texture takes at least its two string lengths, so a damaged count can't
+        // make us allocate more than the file could hold
+        if(!reader.good() || textureCount > reader.remaining() / (2 * sizeof(uint32_t)))
+            return false;
+        vector<Texture> bakedTextures(textureCount);
+        for(Texture &texture : bakedTextures)
+        {
+            texture.id = 0;
+            reader.readString(texture.type);
+            reader.readString(texture.path);
+        }
+        std::map<string, BoneInfo> bakedBones;
+        int bakedBoneCounter = 0;
+        if(withBones)
+        {
+            uint32_t boneCount = 0;
+            reader.read(boneCount);
+            for(uint32_t i = 0; reader.good() && i < boneCount; i++)
+            {
+                string name;
+                BoneInfo info;
+                reader.readString(name);
+                reader.read(info.id);
+                reader.read(info.offset);
+                bakedBones[name] = info;
+            }
+            reader.read(bakedBoneCounter);
+        }
+        if(!reader.good())
+            return false;
+        for(const MeshData &mesh : bakedMeshes)
+            for(uint32_t ref : mesh.textureRefs)
+                if(ref >= textureCount)
+                    return false;
+
+        meshes = std::move(bakedMeshes);
+        textures = std::move(bakedTextures);
+        boneInfoMap = std::move(bakedBones);
+        boneCounter = bakedBoneCounter;
+        bakeFile = std::move(file);
+        return true;
+    }
+};
+#endif
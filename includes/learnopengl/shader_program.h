@@ -0,0 +1,321 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/uniform_cache.h>
+
+// one stage of a program: GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER,
+// GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER or GL_COMPUTE_SHADER
+struct ShaderStage
+{
+    GLenum type;
+    const char* path; // stages with a null path are skipped
+};
+
+// program object built from any combination of shader stages. Linked binaries are kept in
+// cacheDirectory, keyed by a hash of the sources and the driver, so later runs skip
+// compilation; a binary the driver rejects is rebuilt from source.
+class ShaderProgram
+{
+public:
+    unsigned int ID;
+
+    // directory holding linked program binaries, relative to the working directory
+    static inline std::string cacheDirectory = "shader_cache";
+
+    // constructor generates the program on the fly
+    // ------------------------------------------------------------------------
+    ShaderProgram(const std::vector<ShaderStage>& stages)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // 1. retrieve the source code of every stage from its filePath
+        std::vector<std::pair<GLenum, std::string>> sources;
+        std::string name;
+        for (const ShaderStage& stage : stages)
+        {
+            if (stage.path == nullptr)
+                continue;
+            sources.emplace_back(stage.type, readFile(stage.path));
+            name += (name.empty() ? "" : "+") + std::string(stage.path);
+        }
+
+        // 2. reuse a linked binary from an earlier run, or compile and link the stages
+        std::string cachePath = binaryCachePath(sources);
+        ID = glCreateProgram();
+        bool fromCache = !cachePath.empty() && loadBinary(cachePath);
+        if (!fromCache)
+        {
+            if (!cachePath.empty())
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            std::vector<unsigned int> shaders;
+            for (const auto& source : sources)
+            {
+                const char* code = source.second.c_str();
+                unsigned int shader = glCreateShader(source.first);
+                glShaderSource(shader, 1, &code, NULL);
+                glCompileShader(shader);
+                checkCompileErrors(shader, stageName(source.first));
+                glAttachShader(ID, shader);
+                shaders.push_back(shader);
+            }
+            glLinkProgram(ID);
+            bool linked = checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessary
+            for (unsigned int shader : shaders)
+                glDeleteShader(shader);
+            if (linked && !cachePath.empty())
+                saveBinary(cachePath);
+        }
+        uniforms.reflect(ID);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "SHADER::PROGRAM " << name << (fromCache ? " loaded from binary cache in " : " compiled and linked in ")
+                  << ms << " ms" << std::endl;
+    }
+
+    ~ShaderProgram() = default;
+
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() const
+    {
+        GLStateCache::get().useProgram(ID);
+    }
+    // resolves a uniform once, so hot loops can set it without string lookups
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        return uniforms.handle(name);
+    }
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(const std::string &name, bool value) const { setBool(uniform(name), value); }
+    void setInt(const std::string &name, int value) const { setInt(uniform(name), value); }
+    void setFloat(const std::string &name, float value) const { setFloat(uniform(name), value); }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(uniform(name), value); }
+    void setVec2(const std::string &name, float x, float y) const { setVec2(uniform(name), x, y); }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(uniform(name), value); }
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(uniform(name), x, y, z); }
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(uniform(name), value); }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(uniform(name), x, y, z, w); }
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(uniform(name), mat); }
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(uniform(name), mat); }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(uniform(name), mat); }
+    // pre-resolved handle versions, see uniform(name)
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle handle, bool value) const
+    {
+        glUniform1i(handle.location, (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformHandle handle, int value) const
+    {
+        glUniform1i(handle.location, value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(UniformHandle handle, float value) const
+    {
+        glUniform1f(handle.location, value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(UniformHandle handle, const glm::vec2 &value) const
+    {
+        glUniform2fv(handle.location, 1, &value[0]);
+    }
+    void setVec2(UniformHandle handle, float x, float y) const
+    {
+        glUniform2f(handle.location, x, y);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(UniformHandle handle, const glm::vec3 &value) const
+    {
+        glUniform3fv(handle.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle handle, float x, float y, float z) const
+    {
+        glUniform3f(handle.location, x, y, z);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(UniformHandle handle, const glm::vec4 &value) const
+    {
+        glUniform4fv(handle.location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle handle, float x, float y, float z, float w) const
+    {
+        glUniform4f(handle.location, x, y, z, w);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(UniformHandle handle, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(UniformHandle handle, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(UniformHandle handle, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+private:
+    // locations of all active uniforms, filled once after linking
+    UniformCache uniforms;
+
+    static std::string readFile(const char* path)
+    {
+        std::ifstream shaderFile;
+        // ensure ifstream objects can throw exceptions:
+        shaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
+        }
+        catch (std::ifstream::failure& e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+        }
+        return std::string();
+    }
+
+    static std::string stageName(GLenum type)
+    {
+        switch (type)
+        {
+        case GL_VERTEX_SHADER: return "VERTEX";
+        case GL_FRAGMENT_SHADER: return "FRAGMENT";
+        case GL_GEOMETRY_SHADER: return "GEOMETRY";
+        case GL_TESS_CONTROL_SHADER: return "TESS_CONTROL";
+        case GL_TESS_EVALUATION_SHADER: return "TESS_EVALUATION";
+        case GL_COMPUTE_SHADER: return "COMPUTE";
+        }
+        return "UNKNOWN";
+    }
+
+    // FNV-1a, only used to name cache entries
+    static void hashBytes(uint64_t& hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    // cache file for these sources on this driver, or "" when program binaries are unsupported
+    static std::string binaryCachePath(const std::vector<std::pair<GLenum, std::string>>& sources)
+    {
+        GLint formats = 0;
+        if (GLAD_GL_VERSION_4_1)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (formats <= 0)
+            return std::string();
+
+        uint64_t hash = 14695981039346656037ull;
+        for (GLenum driverString : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+        {
+            const char* value = reinterpret_cast<const char*>(glGetString(driverString));
+            if (value)
+                hashBytes(hash, value, std::char_traits<char>::length(value));
+        }
+        for (const auto& source : sources)
+        {
+            hashBytes(hash, &source.first, sizeof(source.first));
+            hashBytes(hash, source.second.data(), source.second.size());
+        }
+        std::stringstream path;
+        path << cacheDirectory << "/" << std::hex << hash << ".bin";
+        return path.str();
+    }
+
+    // file layout: GLenum binaryFormat followed by the program binary
+    bool loadBinary(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        GLenum format = 0;
+        if (!file.read(reinterpret_cast<char*>(&format), sizeof(format)))
+            return false;
+        std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (binary.empty())
+            return false;
+
+        glProgramBinary(ID, format, binary.data(), (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // driver update or corrupt file: start over with a fresh program and compile
+            std::cout << "SHADER::PROGRAM binary cache entry " << path << " rejected, recompiling" << std::endl;
+            glDeleteProgram(ID);
+            ID = glCreateProgram();
+        }
+        return success != 0;
+    }
+
+    void saveBinary(const std::string& path) const
+    {
+        GLint length = 0;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(ID, length, NULL, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(cacheDirectory, error);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(binary.data(), binary.size());
+    }
+
+    // utility function for checking shader compilation/linking errors.
+    // ------------------------------------------------------------------------
+    bool checkCompileErrors(GLuint shader, std::string type)
+    {
+        GLint success;
+        GLchar infoLog[1024];
+        if(type != "PROGRAM")
+        {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if(!success)
+            {
+                glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(shader, GL_LINK_STATUS, &success);
+            if(!success)
+            {
+                glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        return success != 0;
+    }
+};
+#endif
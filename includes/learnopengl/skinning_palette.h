@@ -0,0 +1,99 @@
+#ifndef SKINNING_PALETTE_H
+#define SKINNING_PALETTE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// uniform buffer holding the bone matrices of one or more characters. It matches the
+// std140 block declared in anim_model.vs:
+//
+//   layout(std140) uniform BonePalette { mat4 finalBonesMatrices[MAX_BONES]; };
+//
+// Every character owns one aligned range of the buffer, so a whole palette is uploaded
+// with a single glBufferSubData and selected for a draw with glBindBufferRange.
+class SkinningPalette {
+public:
+    static const int MAX_BONES = 100;
+
+    SkinningPalette(int characterCount = 1, unsigned int bindingPoint = 0)
+        : m_CharacterCount(characterCount), m_BindingPoint(bindingPoint)
+    {
+        // every range bound with glBindBufferRange has to start on this alignment
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        GLsizeiptr paletteSize = MAX_BONES * sizeof(glm::mat4);
+        m_Stride = (paletteSize + alignment - 1) / alignment * alignment;
+
+        glGenBuffers(1, &m_UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+        glBufferData(GL_UNIFORM_BUFFER, m_Stride * m_CharacterCount, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, m_BindingPoint, m_UBO, 0, paletteSize);
+    }
+
+    ~SkinningPalette()
+    {
+        // the demos destroy the palette after glfwTerminate, only free it while a context is alive
+        if (glfwGetCurrentContext())
+            glDeleteBuffers(1, &m_UBO);
+    }
+
+    SkinningPalette(const SkinningPalette &) = delete;
+    SkinningPalette &operator=(const SkinningPalette &) = delete;
+
+    // points the shader's BonePalette block at this palette's binding point
+    void BindShader(unsigned int programID) const
+    {
+        GLuint blockIndex = glGetUniformBlockIndex(programID, "BonePalette");
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(programID, blockIndex, m_BindingPoint);
+    }
+
+    // uploads the palette of one character in a single call
+    void Upload(int character, const glm::mat4 *matrices, int count)
+    {
+        count = std::min(count, (int)MAX_BONES);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, character * m_Stride, count * sizeof(glm::mat4), matrices);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void Upload(int character, const std::vector<glm::mat4> &matrices)
+    {
+        Upload(character, matrices.data(), (int)matrices.size());
+    }
+
+    // uploads MAX_BONES matrices per character for characterCount consecutive characters,
+    // in one call when the ranges are packed without alignment padding
+    void UploadCharacters(int firstCharacter, const glm::mat4 *palettes, int characterCount)
+    {
+        GLsizeiptr paletteSize = MAX_BONES * sizeof(glm::mat4);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_UBO);
+        if (m_Stride == paletteSize)
+            glBufferSubData(GL_UNIFORM_BUFFER, firstCharacter * m_Stride, characterCount * paletteSize, palettes);
+        else
+            for (int i = 0; i < characterCount; i++)
+                glBufferSubData(GL_UNIFORM_BUFFER, (firstCharacter + i) * m_Stride, paletteSize, palettes + i * MAX_BONES);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // selects the range of one character for the following draws
+    void Bind(int character = 0) const
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, m_BindingPoint, m_UBO, character * m_Stride, MAX_BONES * sizeof(glm::mat4));
+    }
+
+    int GetCharacterCount() const { return m_CharacterCount; }
+
+private:
+    unsigned int m_UBO = 0;
+    int m_CharacterCount;
+    unsigned int m_BindingPoint;
+    GLsizeiptr m_Stride;
+};
+#endif
@@ -0,0 +1,318 @@
+#ifndef TEXTURE_BATCH_H
+#define TEXTURE_BATCH_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_compress.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the S3TC formats are an extension glad was generated without
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// texture file as read by a loader thread: stb_image pixels, or the block compressed mip
+// chain of its .ctex file. data is freed by whoever uploads it.
+struct DecodedImage
+{
+    unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    CompressedImage compressed;
+
+    bool loaded() const { return data != nullptr || !compressed.empty(); }
+};
+
+// how texture files are read, decided on the GL thread before loader threads start
+struct TextureReadOptions
+{
+    bool useCompressed = false;  // upload .ctex files where they exist and are up to date
+    bool bakeCompressed = false; // write missing .ctex files, then upload them
+    bool s3tc = false;           // BC1/BC3 can be sampled, BC4/BC5 are core since GL 3.0
+    bool flipped = false;        // stb_image flips images on load
+};
+
+inline DecodedImage decodeImage(const std::string &filename)
+{
+    DecodedImage image;
+    image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    return image;
+}
+
+// reads a texture file: its compressed chain when the options allow it, otherwise the decoded
+// pixels. normalMap textures are compressed to two channel BC5.
+inline DecodedImage readTexture(const std::string &filename, bool normalMap, const TextureReadOptions &options)
+{
+    DecodedImage image;
+    std::string compressedPath = filename + ".ctex";
+    auto usable = [&](uint32_t format) { return options.s3tc || (format != TEXTURE_FORMAT_BC1 && format != TEXTURE_FORMAT_BC3); };
+    if (options.useCompressed && loadCompressedTexture(compressedPath, filename, options.flipped, image.compressed))
+    {
+        if (usable(image.compressed.format))
+            return image;
+        image.compressed = CompressedImage();
+    }
+
+    image = decodeImage(filename);
+    if (image.data && options.bakeCompressed)
+    {
+        uint32_t format = chooseCompressedFormat(image.data, image.width, image.height, image.components, normalMap);
+        if (usable(format))
+        {
+            image.compressed = compressImage(image.data, image.width, image.height, image.components, format);
+            saveCompressedTexture(compressedPath, filename, image.compressed, options.flipped);
+            stbi_image_free(image.data);
+            image.data = nullptr;
+        }
+    }
+    return image;
+}
+
+// GPU memory of the image once uploaded with its mip chain, assuming no driver padding
+inline size_t textureBytes(const DecodedImage &image)
+{
+    if (!image.compressed.empty())
+        return image.compressed.byteSize();
+    return (size_t)image.width * image.height * image.components * 4 / 3;
+}
+
+// stb_image has no getter for its flip flag, so decode a 1x2 gray image and see which row
+// comes first
+inline bool stbiFlipsOnLoad()
+{
+    static const unsigned char probe[] = { 'P', '5', '\n', '1', ' ', '2', '\n', '2', '5', '5', '\n', 0, 255 };
+    int width, height, components;
+    unsigned char *pixels = stbi_load_from_memory(probe, sizeof(probe), &width, &height, &components, 1);
+    bool flipped = pixels && pixels[0] == 255;
+    stbi_image_free(pixels);
+    return flipped;
+}
+
+inline bool hasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, (GLuint)i));
+        if (extension && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// reads all files concurrently, one thread per hardware thread; failed and empty names
+// have no data
+inline std::vector<DecodedImage> readTextures(const std::vector<std::string> &filenames, const std::vector<bool> &normalMaps,
+                                              const TextureReadOptions &options)
+{
+    std::vector<DecodedImage> images(filenames.size());
+    unsigned int threads = std::min<unsigned int>(std::max(1u, std::thread::hardware_concurrency()), (unsigned int)filenames.size());
+    std::atomic<size_t> nextImage(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
+        workers.emplace_back([&]()
+        {
+            for (size_t i = nextImage++; i < filenames.size(); i = nextImage++)
+                if (!filenames[i].empty())
+                    images[i] = readTexture(filenames[i], normalMaps[i], options);
+        });
+    for (std::thread &worker : workers)
+        worker.join();
+    return images;
+}
+
+// uploads a decoded image into texture, with mipmaps and the repeat/trilinear sampling every
+// model texture uses. A non-zero pbo is used as staging buffer; the pixels are copied into
+// it and GL reads them from there.
+inline void uploadImage(unsigned int texture, const DecodedImage &image, unsigned int pbo = 0)
+{
+    if (!image.compressed.empty())
+    {
+        // the mip chain was built offline, no glGenerateMipmap
+        GLStateCache::get().bindTexture(0, texture);
+        const std::vector<CompressedLevel> &levels = image.compressed.levels;
+        for (size_t level = 0; level < levels.size(); level++)
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, image.compressed.format, levels[level].width, levels[level].height, 0,
+                                   (GLsizei)levels[level].blocks.size(), levels[level].blocks.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return;
+    }
+
+    GLenum format = GL_RGB;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
+
+    GLStateCache::get().bindTexture(0, texture);
+    // rows of RED/RGB images aren't 4-byte aligned in general
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const void *pixels = image.data;
+    if (pbo)
+    {
+        size_t size = (size_t)image.width * image.height * image.components;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        // orphan the previous contents so we never wait for an upload still reading them
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (staging)
+        {
+            std::memcpy(staging, image.data, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            pixels = 0; // offset into the bound pixel unpack buffer
+        }
+        else
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// loads a set of textures in two stages: the files are decoded concurrently on worker
+// threads, and every image is uploaded on the calling (GL) thread as soon as it is ready.
+// Uploaded sizes are reported to the TextureCache.
+// add() hands out the texture name right away, so meshes can be built before the pixels
+// arrive; finish() must run before the textures are drawn.
+class TextureBatch
+{
+public:
+    // decode threads per batch, 0 uses one per hardware thread
+    static inline unsigned int threadCount = 0;
+    // use baked .ctex block compressed textures where they exist
+    static inline bool useCompressed = true;
+    // compress textures without a .ctex file on load and write one; slow the first time
+    static inline bool bakeCompressed = false;
+
+    // current settings for readTexture; call on the GL thread
+    static TextureReadOptions readOptions()
+    {
+        TextureReadOptions options;
+        options.useCompressed = useCompressed || bakeCompressed;
+        options.bakeCompressed = bakeCompressed;
+        static bool s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+        options.s3tc = s3tc;
+        options.flipped = stbiFlipsOnLoad();
+        return options;
+    }
+
+    TextureBatch() = default;
+    TextureBatch(const TextureBatch &) = delete;
+    TextureBatch &operator=(const TextureBatch &) = delete;
+    TextureBatch(TextureBatch &&) = default;
+    TextureBatch &operator=(TextureBatch &&) = default;
+
+    ~TextureBatch()
+    {
+        finish();
+    }
+
+    // queues filename for decoding and returns the texture it will be uploaded into
+    unsigned int add(const std::string &filename, bool normalMap = false)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        jobs.push_back({ filename, normalMap, texture, DecodedImage() });
+        return texture;
+    }
+
+    // decodes and uploads everything added so far, returns once all uploads are issued
+    void finish()
+    {
+        if (jobs.empty())
+            return;
+        auto start = std::chrono::steady_clock::now();
+        TextureReadOptions options = readOptions();
+
+        unsigned int threads = threadCount ? threadCount : std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned int>(threads, (unsigned int)jobs.size());
+        std::atomic<size_t> nextJob(0);
+        std::vector<size_t> decoded; // indices of jobs ready for upload
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; t++)
+            workers.emplace_back([&]()
+            {
+                for (size_t job = nextJob++; job < jobs.size(); job = nextJob++)
+                {
+                    jobs[job].image = readTexture(jobs[job].filename, jobs[job].normalMap, options);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    decoded.push_back(job);
+                    ready.notify_one();
+                }
+            });
+
+        // two staging buffers, so filling one doesn't wait for the transfer out of the other
+        unsigned int pbos[2] = { 0, 0 };
+        glGenBuffers(2, pbos);
+        for (size_t uploaded = 0; uploaded < jobs.size(); uploaded++)
+        {
+            size_t job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&]() { return !decoded.empty(); });
+                job = decoded.back();
+                decoded.pop_back();
+            }
+            Job &current = jobs[job];
+            if (current.image.loaded())
+            {
+                uploadImage(current.texture, current.image, pbos[uploaded % 2]);
+                TextureCache::get().setBytes(current.texture, textureBytes(current.image));
+            }
+            else
+                std::cout << "Texture failed to load at path: " << current.filename << std::endl;
+            stbi_image_free(current.image.data);
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+        glDeleteBuffers(2, pbos);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "TEXTURE::BATCH " << jobs.size() << " textures decoded on " << threads << " threads and uploaded in "
+                  << ms << " ms" << std::endl;
+        jobs.clear();
+    }
+
+private:
+    struct Job
+    {
+        std::string filename;
+        bool normalMap;
+        unsigned int texture;
+        DecodedImage image;
+    };
+    std::vector<Job> jobs;
+};
+#endif
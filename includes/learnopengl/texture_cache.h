@@ -0,0 +1,223 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// process-wide table of loaded textures, keyed by absolute file path, so every Model that
+// uses a file shares one GL texture. Entries are reference counted; unreferenced textures
+// stay resident for later loads until the budget forces them out, least recently used
+// first. All members lock, so the table can be queried from loader threads.
+class TextureCache
+{
+public:
+    static TextureCache &get()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // returns the texture loaded from path with one more reference, or 0 if it isn't cached
+    unsigned int acquire(const std::string &path)
+    {
+        std::string name = key(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = entries.find(name);
+        if (iter == entries.end())
+        {
+            misses++;
+            return 0;
+        }
+        hits++;
+        iter->second.references++;
+        iter->second.lastUse = ++useClock;
+        return iter->second.texture;
+    }
+
+    // true if path is cached; doesn't count as a use
+    bool contains(const std::string &path)
+    {
+        std::string name = key(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.count(name) != 0;
+    }
+
+    // registers a texture just created for path, holding one reference
+    void insert(const std::string &path, unsigned int texture)
+    {
+        std::string name = key(path);
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry entry;
+        entry.texture = texture;
+        entry.lastUse = ++useClock;
+        keys[texture] = name;
+        entries[name] = entry;
+    }
+
+    // records the GPU memory of a cached texture once its pixels are uploaded
+    void setBytes(unsigned int texture, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto name = keys.find(texture);
+        if (name == keys.end())
+            return;
+        Entry &entry = entries[name->second];
+        residentBytes += bytes - entry.bytes;
+        entry.bytes = bytes;
+        evict();
+    }
+
+    void release(unsigned int texture)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto name = keys.find(texture);
+        if (name == keys.end())
+            return;
+        Entry &entry = entries[name->second];
+        if (entry.references > 0)
+            entry.references--;
+        evict();
+    }
+
+    // GPU memory the cached textures may use, 0 for no limit. Only unreferenced textures are
+    // evicted, so textures in use can still exceed it.
+    void setBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budgetBytes = bytes;
+        evict();
+    }
+
+    size_t getResidentBytes()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return residentBytes;
+    }
+
+    // lookups that found a texture
+    unsigned long getHits()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+
+    // lookups that had to load one
+    unsigned long getMisses()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return misses;
+    }
+
+    void printStats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "TEXTURE::CACHE " << entries.size() << " textures, " << hits << " hits, " << misses << " misses, "
+                  << residentBytes / (1024.0 * 1024.0) << " MB resident" << std::endl;
+    }
+
+private:
+    struct Entry
+    {
+        unsigned int texture = 0;
+        unsigned int references = 1;
+        size_t bytes = 0;
+        uint64_t lastUse = 0;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<unsigned int, std::string> keys; // texture -> entries key
+    size_t residentBytes = 0;
+    size_t budgetBytes = 0;
+    uint64_t useClock = 0;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    std::mutex mutex;
+
+    // "dir/../textures/a.png" and "textures/a.png" name the same file; touches the file
+    // system, so callers compute it before taking the lock
+    static std::string key(const std::string &path)
+    {
+        std::error_code error;
+        std::filesystem::path absolute = std::filesystem::weakly_canonical(std::filesystem::absolute(path, error), error);
+        return error ? path : absolute.string();
+    }
+
+    // drops unreferenced textures, oldest use first, until we're within budget; needs the GL
+    // context, so nothing is freed after the window is gone
+    void evict()
+    {
+        if (budgetBytes == 0 || !glfwGetCurrentContext())
+            return;
+        while (residentBytes > budgetBytes)
+        {
+            auto victim = entries.end();
+            for (auto iter = entries.begin(); iter != entries.end(); ++iter)
+                if (iter->second.references == 0 && (victim == entries.end() || iter->second.lastUse < victim->second.lastUse))
+                    victim = iter;
+            if (victim == entries.end())
+                return;
+            GLStateCache::get().forgetTexture(victim->second.texture);
+            glDeleteTextures(1, &victim->second.texture);
+            residentBytes -= victim->second.bytes;
+            keys.erase(victim->second.texture);
+            entries.erase(victim);
+        }
+    }
+};
+
+// the references one owner, e.g. a Model, holds on cached textures; released together
+// when the owner goes away
+class TextureReferences
+{
+public:
+    TextureReferences() = default;
+    TextureReferences(const TextureReferences &) = delete;
+    TextureReferences &operator=(const TextureReferences &) = delete;
+
+    TextureReferences(TextureReferences &&other) noexcept : textures(std::move(other.textures))
+    {
+        other.textures.clear();
+    }
+
+    TextureReferences &operator=(TextureReferences &&other) noexcept
+    {
+        if (this != &other)
+        {
+            releaseAll();
+            textures = std::move(other.textures);
+            other.textures.clear();
+        }
+        return *this;
+    }
+
+    ~TextureReferences()
+    {
+        releaseAll();
+    }
+
+    void add(unsigned int texture)
+    {
+        textures.push_back(texture);
+    }
+
+    void releaseAll()
+    {
+        for (unsigned int texture : textures)
+            TextureCache::get().release(texture);
+        textures.clear();
+    }
+
+private:
+    std::vector<unsigned int> textures;
+};
+#endif
@@ -0,0 +1,388 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <learnopengl/baked_asset.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU block compression into the BCn formats GL can sample directly. Nothing in here
+// touches GL, so textures can be baked and checked headless.
+//
+//   BC1  4 bpp  RGB                     GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+//   BC3  8 bpp  RGBA, BC1 color + BC4 alpha  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+//   BC4  4 bpp  R                       GL_COMPRESSED_RED_RGTC1
+//   BC5  8 bpp  RG, two BC4 blocks      GL_COMPRESSED_RG_RGTC2
+//
+// A compressed texture file (".ctex", next to the source image) is a BakeHeader followed by
+// uint32 format, uint32 flipped, uint32 level count and per level uint32 width, uint32 height
+// and the blocks of that level, largest level first.
+
+const uint32_t TEXTURE_FORMAT_BC1 = 0x83F0;
+const uint32_t TEXTURE_FORMAT_BC3 = 0x83F3;
+const uint32_t TEXTURE_FORMAT_BC4 = 0x8DBB;
+const uint32_t TEXTURE_FORMAT_BC5 = 0x8DBD;
+
+// bytes per 4x4 block of format, 0 for formats we don't write
+inline size_t compressedBlockBytes(uint32_t format)
+{
+    if (format == TEXTURE_FORMAT_BC1 || format == TEXTURE_FORMAT_BC4)
+        return 8;
+    if (format == TEXTURE_FORMAT_BC3 || format == TEXTURE_FORMAT_BC5)
+        return 16;
+    return 0;
+}
+
+struct CompressedLevel
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> blocks;
+};
+
+struct CompressedImage
+{
+    uint32_t format = 0;
+    std::vector<CompressedLevel> levels;
+
+    bool empty() const { return levels.empty(); }
+
+    size_t byteSize() const
+    {
+        size_t size = 0;
+        for (const CompressedLevel &level : levels)
+            size += level.blocks.size();
+        return size;
+    }
+};
+
+namespace bc
+{
+    inline uint16_t packRGB565(const float color[3])
+    {
+        int r = std::clamp((int)std::lround(color[0] * 31.0f / 255.0f), 0, 31);
+        int g = std::clamp((int)std::lround(color[1] * 63.0f / 255.0f), 0, 63);
+        int b = std::clamp((int)std::lround(color[2] * 31.0f / 255.0f), 0, 31);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackRGB565(uint16_t packed, float color[3])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (float)((r << 3) | (r >> 2));
+        color[1] = (float)((g << 2) | (g >> 4));
+        color[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // picks the nearest of the four BC1 palette entries for every pixel, returns the total error
+    inline float fitIndices(const float pixels[16][3], uint16_t c0, uint16_t c1, uint32_t &indices)
+    {
+        float palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+        float total = 0.0f;
+        indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestError = 1e30f;
+            for (int p = 0; p < 4; p++)
+            {
+                float dr = pixels[i][0] - palette[p][0], dg = pixels[i][1] - palette[p][1], db = pixels[i][2] - palette[p][2];
+                float error = dr * dr + dg * dg + db * db;
+                if (error < bestError)
+                {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+            total += bestError;
+        }
+        return total;
+    }
+
+    // BC1 block: endpoints from the principal axis of the block's colors, refined once by
+    // least squares against the chosen indices
+    inline void encodeColorBlock(const unsigned char rgba[16][4], unsigned char out[8])
+    {
+        float pixels[16][3];
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++)
+            {
+                pixels[i][c] = rgba[i][c];
+                mean[c] += pixels[i][c] / 16.0f;
+            }
+
+        float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++)
+        {
+            float r = pixels[i][0] - mean[0], g = pixels[i][1] - mean[1], b = pixels[i][2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        float minT = 1e30f, maxT = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float high[3], low[3];
+        for (int c = 0; c < 3; c++)
+        {
+            float scale = axisLength2 > 0.0f ? axis[c] / axisLength2 : 0.0f;
+            high[c] = mean[c] + maxT * scale;
+            low[c] = mean[c] + minT * scale;
+        }
+
+        uint16_t c0 = packRGB565(high), c1 = packRGB565(low);
+        uint32_t indices = 0;
+        float error = fitIndices(pixels, c0, c1, indices);
+
+        // least squares endpoints for the indices found, keep them if they fit better
+        const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+        for (int i = 0; i < 16; i++)
+        {
+            float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a; bb += b * b; ab += a * b;
+            for (int c = 0; c < 3; c++)
+            {
+                ax[c] += a * pixels[i][c];
+                bx[c] += b * pixels[i][c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) > 1e-6f)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                high[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+                low[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+            }
+            uint16_t r0 = packRGB565(high), r1 = packRGB565(low);
+            uint32_t refinedIndices = 0;
+            float refinedError = fitIndices(pixels, r0, r1, refinedIndices);
+            if (refinedError < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                indices = refinedIndices;
+            }
+        }
+
+        // c0 > c1 selects the four color mode; swapping the endpoints swaps index 0/1 and 2/3
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+            indices ^= 0x55555555u;
+        }
+        else if (c0 == c1)
+            indices = 0;
+        out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+        out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // BC4 block of one channel: endpoints at the channel's min/max in the eight value mode
+    inline void encodeChannelBlock(const unsigned char rgba[16][4], int channel, unsigned char out[8])
+    {
+        int low = 255, high = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            low = std::min(low, (int)rgba[i][channel]);
+            high = std::max(high, (int)rgba[i][channel]);
+        }
+        out[0] = (unsigned char)high;
+        out[1] = (unsigned char)low;
+        uint64_t indices = 0;
+        if (high > low)
+            for (int i = 0; i < 16; i++)
+            {
+                // position 0 is the high endpoint, 7 the low one; codes are 0, 2..7, 1 along the ramp
+                int step = (int)std::lround((high - rgba[i][channel]) * 7.0f / (high - low));
+                uint64_t code = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+                indices |= code << (3 * i);
+            }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // 4x4 block at (bx, by), edge pixels repeated where the block sticks out of the image
+    inline void fetchBlock(const unsigned char *pixels, int width, int height, int components, int bx, int by, unsigned char block[16][4])
+    {
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+            {
+                int px = std::min(bx * 4 + x, width - 1), py = std::min(by * 4 + y, height - 1);
+                const unsigned char *source = pixels + ((size_t)py * width + px) * components;
+                unsigned char *target = block[y * 4 + x];
+                target[0] = source[0];
+                target[1] = components > 1 ? source[1] : source[0];
+                target[2] = components > 2 ? source[2] : source[0];
+                target[3] = components > 3 ? source[3] : 255;
+                if (components == 2)
+                    target[2] = 0;
+            }
+    }
+
+    // halves an image with a box filter, odd edges fold into the last pixel
+    inline std::vector<unsigned char> downsample(const std::vector<unsigned char> &pixels, int width, int height, int components)
+    {
+        int newWidth = std::max(1, width / 2), newHeight = std::max(1, height / 2);
+        std::vector<unsigned char> result((size_t)newWidth * newHeight * components);
+        for (int y = 0; y < newHeight; y++)
+            for (int x = 0; x < newWidth; x++)
+                for (int c = 0; c < components; c++)
+                {
+                    int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+                    int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+                    int sum = pixels[((size_t)y0 * width + x0) * components + c] + pixels[((size_t)y0 * width + x1) * components + c] +
+                              pixels[((size_t)y1 * width + x0) * components + c] + pixels[((size_t)y1 * width + x1) * components + c];
+                    result[((size_t)y * newWidth + x) * components + c] = (unsigned char)((sum + 2) / 4);
+                }
+        return result;
+    }
+}
+
+// block format for an image: BC5 for normal maps (x and y only, z has to be rebuilt in the
+// shader), BC4 for one channel, BC3 when there is alpha other than 255, BC1 otherwise
+inline uint32_t chooseCompressedFormat(const unsigned char *pixels, int width, int height, int components, bool normalMap)
+{
+    if (normalMap || components == 2)
+        return TEXTURE_FORMAT_BC5;
+    if (components == 1)
+        return TEXTURE_FORMAT_BC4;
+    if (components == 4)
+        for (size_t i = 0; i < (size_t)width * height; i++)
+            if (pixels[i * 4 + 3] != 255)
+                return TEXTURE_FORMAT_BC3;
+    return TEXTURE_FORMAT_BC1;
+}
+
+// compresses an 8 bit image with 1-4 components and its full mip chain down to 1x1
+inline CompressedImage compressImage(const unsigned char *pixels, int width, int height, int components, uint32_t format)
+{
+    CompressedImage image;
+    image.format = format;
+    size_t blockSize = compressedBlockBytes(format);
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * components);
+    while (true)
+    {
+        CompressedLevel compressed;
+        compressed.width = width;
+        compressed.height = height;
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        compressed.blocks.resize((size_t)blocksX * blocksY * blockSize);
+        unsigned char *out = compressed.blocks.data();
+        unsigned char block[16][4];
+        for (int by = 0; by < blocksY; by++)
+            for (int bx = 0; bx < blocksX; bx++, out += blockSize)
+            {
+                bc::fetchBlock(level.data(), width, height, components, bx, by, block);
+                if (format == TEXTURE_FORMAT_BC1)
+                    bc::encodeColorBlock(block, out);
+                else if (format == TEXTURE_FORMAT_BC3)
+                {
+                    bc::encodeChannelBlock(block, 3, out);
+                    bc::encodeColorBlock(block, out + 8);
+                }
+                else if (format == TEXTURE_FORMAT_BC4)
+                    bc::encodeChannelBlock(block, 0, out);
+                else
+                {
+                    bc::encodeChannelBlock(block, 0, out);
+                    bc::encodeChannelBlock(block, 1, out + 8);
+                }
+            }
+        image.levels.push_back(std::move(compressed));
+        if (width == 1 && height == 1)
+            break;
+        level = bc::downsample(level, width, height, components);
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return image;
+}
+
+const char COMPRESSED_TEXTURE_MAGIC[4] = { 'C', 'T', 'E', 'X' };
+
+// writes the compressed chain of sourcePath; flipped records how the source was decoded
+inline bool saveCompressedTexture(const std::string &path, const std::string &sourcePath, const CompressedImage &image, bool flipped)
+{
+    BakeWriter writer;
+    if (!beginBake(writer, COMPRESSED_TEXTURE_MAGIC, sourcePath))
+        return false;
+    writer.write(image.format);
+    writer.write((uint32_t)flipped);
+    writer.write((uint32_t)image.levels.size());
+    for (const CompressedLevel &level : image.levels)
+    {
+        writer.write((uint32_t)level.width);
+        writer.write((uint32_t)level.height);
+        writer.writeArray(level.blocks);
+    }
+    return writer.save(path);
+}
+
+// reads a compressed chain that is up to date with sourcePath and decoded with the same flip.
+// The format has to be one we write and every level exactly as many blocks as its size
+// needs, since GL is handed the blocks as they are; otherwise the caller decodes the source.
+inline bool loadCompressedTexture(const std::string &path, const std::string &sourcePath, bool flipped, CompressedImage &image)
+{
+    MappedFile file;
+    if (!openBake(file, path, COMPRESSED_TEXTURE_MAGIC, sourcePath))
+        return false;
+    BakeReader reader = bakePayload(file);
+    uint32_t format = 0, fileFlipped = 0, levelCount = 0;
+    reader.read(format);
+    reader.read(fileFlipped);
+    reader.read(levelCount);
+    size_t blockBytes = compressedBlockBytes(format);
+    if (!reader.good() || blockBytes == 0 || fileFlipped != (uint32_t)flipped || levelCount == 0 || levelCount > 32)
+        return false;
+    CompressedImage result;
+    result.format = format;
+    for (uint32_t i = 0; i < levelCount; i++)
+    {
+        CompressedLevel level;
+        uint32_t width = 0, height = 0, size = 0;
+        reader.read(width);
+        reader.read(height);
+        const unsigned char *blocks = reader.readArray<unsigned char>(size);
+        if (!reader.good() || width == 0 || height == 0 || width > 65536 || height > 65536 ||
+            size != (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes)
+            return false;
+        level.width = (int)width;
+        level.height = (int)height;
+        level.blocks.assign(blocks, blocks + size);
+        result.levels.push_back(std::move(level));
+    }
+    image = std::move(result);
+    return true;
+}
+#endif
@@ -0,0 +1,79 @@
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// location of a uniform resolved once, so per-frame code never passes strings around.
+// A handle of an unknown or optimized-out uniform has location -1, which GL ignores.
+struct UniformHandle
+{
+    GLint location = -1;
+
+    bool valid() const { return location >= 0; }
+};
+
+// flat, sorted table of every active uniform of a linked program
+class UniformCache
+{
+public:
+    // reads all active uniforms of the program; call after a successful link
+    void reflect(GLuint program)
+    {
+        entries.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue; // members of uniform blocks have no location
+            entries.emplace_back(name, location);
+
+            // arrays are reported as "name[0]"; also register the bare name and every element
+            std::string::size_type bracket = name.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == name.size())
+            {
+                std::string base = name.substr(0, bracket);
+                entries.emplace_back(base, location);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    entries.emplace_back(elementName, glGetUniformLocation(program, elementName.c_str()));
+                }
+            }
+        }
+        std::sort(entries.begin(), entries.end());
+    }
+
+    GLint location(const std::string &name) const
+    {
+        auto iter = std::lower_bound(entries.begin(), entries.end(), name,
+            [](const std::pair<std::string, GLint> &entry, const std::string &key) { return entry.first < key; });
+        if (iter == entries.end() || iter->first != name)
+            return -1;
+        return iter->second;
+    }
+
+    UniformHandle handle(const std::string &name) const
+    {
+        UniformHandle h;
+        h.location = location(name);
+        return h;
+    }
+
+private:
+    std::vector<std::pair<std::string, GLint>> entries;
+};
+#endif
@@ -0,0 +1,140 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// how the vertices of a Mesh are stored on the GPU
+//
+//   Full            88 bytes  the Vertex struct as is
+//   CompactSkinned  36 bytes  float3 position, octahedral snorm16x2 normal/tangent/bitangent,
+//                             half2 uv, uint8x4 bone ids, unorm8x4 weights
+//   CompactStatic   28 bytes  CompactSkinned without the bone ids and weights
+//
+// Compact normals, tangents and bitangents arrive in the shader as a vec2 that has to be
+// decoded:
+//
+//   vec3 octDecode(vec2 e)
+//   {
+//       vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+//       if (v.z < 0.0)
+//           v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+//       return normalize(v);
+//   }
+//
+// Unused bone slots are stored as bone 0 with weight 0, so skinning them adds nothing.
+// Worst case errors against the Full layout: normals/tangents 0.04 degrees, uvs in [0, 1]
+// 2^-12 (relative 2^-11 beyond), each weight 1.5/255 with the weights still summing to one.
+enum class VertexFormat
+{
+    Full,
+    CompactSkinned,
+    CompactStatic
+};
+
+// one attribute of a vertex buffer, as passed to glVertexAttrib(I)Pointer
+struct VertexAttribute
+{
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;   // read as int/ivec in the shader
+    size_t offset;
+};
+
+struct VertexLayout
+{
+    GLsizei stride;
+    std::vector<VertexAttribute> attributes;
+
+    // enables and points every attribute at the currently bound GL_ARRAY_BUFFER
+    void apply() const
+    {
+        for (const VertexAttribute &attribute : attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            if (attribute.integer)
+                glVertexAttribIPointer(attribute.location, attribute.size, attribute.type, stride, (void *)attribute.offset);
+            else
+                glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, stride, (void *)attribute.offset);
+        }
+    }
+};
+
+// octahedral mapping of a unit vector onto [-1, 1]^2
+inline glm::vec2 octEncode(glm::vec3 v)
+{
+    float length = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+    if (!(length > 0.0f) || !std::isfinite(length))
+        return glm::vec2(0.0f, 0.0f); // degenerate input decodes to +z
+    v /= length;
+    glm::vec2 e(v.x, v.y);
+    if (v.z < 0.0f)
+        e = glm::vec2((1.0f - std::fabs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+    return e;
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+    glm::vec3 v(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (v.z < 0.0f)
+        v = glm::vec3((1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f),
+                      (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f), v.z);
+    return glm::normalize(v);
+}
+
+// octahedral encoding in two snorm16, rounded to the code that decodes closest to v
+inline uint32_t packOctSnorm16(glm::vec3 v)
+{
+    glm::vec2 e = octEncode(v);
+    float length = glm::length(v);
+    if (!(length > 0.0f) || !std::isfinite(length))
+        return glm::packSnorm2x16(e);
+    v /= length;
+    glm::vec2 base = glm::floor(glm::clamp(e, -1.0f, 1.0f) * 32767.0f);
+    uint32_t best = 0;
+    float bestDot = -2.0f;
+    for (int dx = 0; dx <= 1; dx++)
+        for (int dy = 0; dy <= 1; dy++)
+        {
+            glm::vec2 candidate = glm::clamp((base + glm::vec2(dx, dy)) / 32767.0f, -1.0f, 1.0f);
+            float dot = glm::dot(octDecode(candidate), v);
+            if (dot > bestDot)
+            {
+                bestDot = dot;
+                best = glm::packSnorm2x16(candidate);
+            }
+        }
+    return best;
+}
+
+// four weights as unorm8 that still sum to exactly 255
+inline uint32_t packWeightsUnorm8(const float weights[4])
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 4; i++)
+        sum += std::max(weights[i], 0.0f);
+    if (!(sum > 0.0f))
+        return 0;
+    int quantized[4], total = 0, largest = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        quantized[i] = (int)std::lround(std::max(weights[i], 0.0f) / sum * 255.0f);
+        total += quantized[i];
+        if (quantized[i] > quantized[largest])
+            largest = i;
+    }
+    quantized[largest] = std::clamp(quantized[largest] + 255 - total, 0, 255);
+    return (uint32_t)quantized[0] | (uint32_t)quantized[1] << 8 | (uint32_t)quantized[2] << 16 | (uint32_t)quantized[3] << 24;
+}
+#endif
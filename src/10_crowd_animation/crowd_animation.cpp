@@ -0,0 +1,105 @@
+// Headless crowd benchmark: animates a crowd of mixamo characters with AnimationWorld
+// on 1 to N threads and reports how many characters are updated per millisecond, first
+// through the per bone glm path and then through the pose kernel.
+//
+//   10_crowd_animation [characters] [frames]
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/animation.h>
+#include <learnopengl/animation_world.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// settings
+const int DEFAULT_CHARACTERS = 2000;
+const int DEFAULT_FRAMES = 200;
+const int WARMUP_FRAMES = 10;
+const float FRAME_TIME = 1.0f / 60.0f;
+
+// fills world with characters cycling through the clips with staggered start times, every
+// fourth character cross-fading into the next clip
+void populate(AnimationWorld &world, std::vector<Animation *> &clips, int characters)
+{
+  for (int i = 0; i < characters; i++)
+  {
+    Animation *clip = clips[i % clips.size()];
+    float startTime = std::fmod(i * 7.0f, clip->GetDuration());
+    world.AddCharacter(clip, startTime);
+    if (i % 4 == 3)
+      world.GetAnimator(i).PlayAnimation(clip, clips[(i + 1) % clips.size()], startTime, 0.0f, 0.5f);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int characters = argc > 1 ? std::max(1, std::atoi(argv[1])) : DEFAULT_CHARACTERS;
+  int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : DEFAULT_FRAMES;
+
+  // load the skeleton and the clips, no window or GL context needed
+  // -----------
+  Model skeleton = Model::loadSkeleton(FileSystem::getPath("resources/objects/mixamo_2/kachujin.dae"));
+  Animation idleAnimation(FileSystem::getPath("resources/objects/mixamo_2/idle.dae"), &skeleton);
+  Animation walkAnimation(FileSystem::getPath("resources/objects/mixamo_2/walk.dae"), &skeleton);
+  Animation runAnimation(FileSystem::getPath("resources/objects/mixamo_2/run.dae"), &skeleton);
+  Animation punchAnimation(FileSystem::getPath("resources/objects/mixamo_2/punch.dae"), &skeleton);
+  Animation kickAnimation(FileSystem::getPath("resources/objects/mixamo_2/kick.dae"), &skeleton);
+  std::vector<Animation *> clips = { &idleAnimation, &walkAnimation, &runAnimation, &punchAnimation, &kickAnimation };
+
+  // 1, 2, 4, ... threads and every hardware thread
+  int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+  std::vector<int> threadCounts;
+  for (int threads = 1; threads < maxThreads; threads *= 2)
+    threadCounts.push_back(threads);
+  threadCounts.push_back(maxThreads);
+  // run 0 is the glm path on one thread, the reference of all others
+  threadCounts.insert(threadCounts.begin(), 1);
+
+  std::cout << characters << " characters, " << skeleton.GetBoneCount() << " bones, " << frames << " frames, "
+            << PoseKernelName() << " pose kernel" << std::endl;
+  std::vector<glm::mat4> reference;
+  double singleThreadRate = 0.0;
+  for (size_t run = 0; run < threadCounts.size(); run++)
+  {
+    int threads = threadCounts[run];
+    Animator::s_UsePoseKernel = run > 0;
+    JobSystem jobs(threads);
+    AnimationWorld world(jobs);
+    populate(world, clips, characters);
+    for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+      world.UpdateAnimation(FRAME_TIME);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+      world.UpdateAnimation(FRAME_TIME);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // every run plays the same frames, so all of them have to end in the same poses, up
+    // to the rounding of the pose kernel
+    const glm::mat4 *palettes = world.GetPalettes();
+    float difference = 0.0f;
+    if (reference.empty())
+      reference.assign(palettes, palettes + characters * AnimationWorld::MAX_BONES);
+    for (size_t i = 0; i < reference.size(); i++)
+      for (int column = 0; column < 4; column++)
+      {
+        glm::vec4 delta = glm::abs(reference[i][column] - palettes[i][column]);
+        difference = std::max(difference, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+      }
+
+    double rate = (double)characters * frames / ms;
+    if (run <= 1)
+      singleThreadRate = rate;
+    std::cout << (run == 0 ? "glm path, " : "pose kernel, ") << threads << " thread(s): " << ms / frames
+              << " ms per frame, " << rate << " characters/ms, " << rate / singleThreadRate
+              << "x, max difference to the glm path " << difference << std::endl;
+  }
+  return 0;
+}
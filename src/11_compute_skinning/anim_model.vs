@@ -0,0 +1,39 @@
+#version 330 core
+layout(location = 0) in vec3 pos;
+layout(location = 2) in vec2 tex;
+layout(location = 5) in ivec4 boneIds;
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 lightSpace;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+layout(std140) uniform BonePalette
+{
+    mat4 finalBonesMatrices[MAX_BONES];
+};
+
+out vec2 TexCoords;
+out vec4 LightSpacePos;
+
+void main()
+{
+    // blend the bone matrices and transform once; ids outside the palette get weight 0
+    mat4 skinMatrix = mat4(0.0);
+    float skinnedWeight = 0.0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        float weight = boneIds[i] >= 0 && boneIds[i] < MAX_BONES ? weights[i] : 0.0;
+        skinMatrix += finalBonesMatrices[clamp(boneIds[i], 0, MAX_BONES - 1)] * weight;
+        skinnedWeight += weight;
+    }
+    skinMatrix += mat4(1.0 - skinnedWeight);
+
+    vec4 worldPos = model * skinMatrix * vec4(pos, 1.0);
+    gl_Position = projection * view * worldPos;
+    LightSpacePos = lightSpace * worldPos;
+    TexCoords = tex;
+}
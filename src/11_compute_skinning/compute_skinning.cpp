@@ -0,0 +1,428 @@
+// Skinning benchmark: a crowd of mixamo characters drawn with one to three passes (main,
+// depth prepass, shadow map), skinned either in the vertex shader of every pass or once
+// per frame by a compute shader whose output all passes draw as a static mesh. At startup
+// every combination is timed with GPU timer queries and the compute result is checked
+// against the CPU reference skinner; then C switches the skinning path and 1/2/3 the
+// number of passes.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/shader_c.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/animation_world.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/skinning_palette.h>
+#include <learnopengl/compute_skinning.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void mouse_callback(GLFWwindow *window, double xpos, double ypos);
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+
+// settings
+const unsigned int SCR_WIDTH = 1000;
+const unsigned int SCR_HEIGHT = 800;
+const unsigned int SHADOW_SIZE = 2048;
+
+// the crowd: GRID_SIZE x GRID_SIZE characters
+const int GRID_SIZE = 8;
+const float GRID_SPACING = 1.2f;
+
+// benchmark: frames per combination of skinning path and pass count
+const int WARMUP_FRAMES = 10;
+const int BENCHMARK_FRAMES = 120;
+
+// camera
+Camera camera(glm::vec3(0.0f, 3.0f, 9.0f));
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+enum SkinningPath
+{
+  VERTEX_SHADER_SKINNING,
+  COMPUTE_SKINNING,
+};
+const char *pathNames[] = { "vertex shader", "compute" };
+
+// C toggles the skinning path, 1/2/3 select main only, + depth prepass, + shadow map
+SkinningPath skinningPath = VERTEX_SHADER_SKINNING;
+int passCount = 3;
+bool cPressed = false;
+
+int main()
+{
+  // glfw: initialize and configure
+  // ------------------------------
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  // glfw window creation
+  // --------------------
+  GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+  if (window == NULL)
+  {
+    // no GL 4.3 here: only the vertex shader path is available
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+  }
+  if (window == NULL)
+  {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetCursorPosCallback(window, mouse_callback);
+  glfwSetScrollCallback(window, scroll_callback);
+
+  // tell GLFW to capture our mouse
+  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+  // don't wait for vsync, the benchmark wants every frame it can get
+  glfwSwapInterval(0);
+
+  // glad: load all OpenGL function pointers
+  // ---------------------------------------
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+  {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return -1;
+  }
+  bool computeAvailable = ComputeSkinning::supported();
+  std::cout << "compute skinning " << (computeAvailable ? "available" : "unavailable, skinning in the vertex shader")
+            << std::endl;
+
+  // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
+  stbi_set_flip_vertically_on_load(true);
+
+  // configure global opengl state
+  // -----------------------------
+  glEnable(GL_DEPTH_TEST);
+
+  // build and compile shaders: per pass, one skinning in the vertex shader and one
+  // drawing the vertices skinned by the compute shader
+  // -------------------------
+  Shader skinnedShader("anim_model.vs", "model.fs");
+  Shader skinnedDepthShader("anim_model.vs", "depth.fs");
+  Shader staticShader("static_model.vs", "model.fs");
+  Shader staticDepthShader("static_model.vs", "depth.fs");
+  ComputeShader *skinningShader = computeAvailable ? new ComputeShader("skinning.cs") : NULL;
+
+  // load the character, keeping its vertices for the CPU reference, and the clips
+  // -----------
+  Model ourModel(FileSystem::getPath("resources/objects/mixamo_2/kachujin.dae"), false, true, VertexFormat::CompactSkinned);
+  ourModel.packMeshes();
+  Animation idleAnimation(FileSystem::getPath("resources/objects/mixamo_2/idle.dae"), &ourModel);
+  Animation walkAnimation(FileSystem::getPath("resources/objects/mixamo_2/walk.dae"), &ourModel);
+  Animation runAnimation(FileSystem::getPath("resources/objects/mixamo_2/run.dae"), &ourModel);
+  Animation punchAnimation(FileSystem::getPath("resources/objects/mixamo_2/punch.dae"), &ourModel);
+  Animation kickAnimation(FileSystem::getPath("resources/objects/mixamo_2/kick.dae"), &ourModel);
+  std::vector<Animation *> clips = { &idleAnimation, &walkAnimation, &runAnimation, &punchAnimation, &kickAnimation };
+
+  // the crowd, animated on every core into one palette buffer
+  const int characters = GRID_SIZE * GRID_SIZE;
+  JobSystem jobs;
+  AnimationWorld world(jobs);
+  std::vector<glm::mat4> modelMatrices;
+  for (int i = 0; i < characters; i++)
+  {
+    Animation *clip = clips[i % clips.size()];
+    world.AddCharacter(clip, std::fmod(i * 7.0f, clip->GetDuration()));
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((i % GRID_SIZE - GRID_SIZE / 2) * GRID_SPACING, 0.0f,
+                                                                (i / GRID_SIZE - GRID_SIZE / 2) * GRID_SPACING));
+    modelMatrices.push_back(glm::scale(model, glm::vec3(0.5f)));
+  }
+  SkinningPalette bonePalette(characters);
+  bonePalette.BindShader(skinnedShader.ID);
+  bonePalette.BindShader(skinnedDepthShader.ID);
+  std::vector<ComputeSkinning> skinnings(characters);
+  if (skinningShader)
+  {
+    bonePalette.BindShader(skinningShader->ID);
+    for (ComputeSkinning &skinning : skinnings)
+      skinning.build(ourModel);
+  }
+
+  // shadow map of a directional light over the crowd
+  // ----------------------------------------------
+  const unsigned int SHADOW_UNIT = 8;
+  unsigned int shadowFBO, shadowMap;
+  glGenFramebuffers(1, &shadowFBO);
+  glGenTextures(1, &shadowMap);
+  GLStateCache::get().bindTexture(SHADOW_UNIT, shadowMap);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_SIZE, SHADOW_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowMap, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glm::mat4 lightSpace = glm::ortho(-8.0f, 8.0f, -8.0f, 8.0f, 1.0f, 30.0f) *
+                         glm::lookAt(glm::vec3(-6.0f, 12.0f, 6.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+  // draws the crowd with shader, skinned along path
+  auto drawCrowd = [&](SkinningPath path, Shader &shader, const glm::mat4 &projection, const glm::mat4 &view)
+  {
+    shader.use();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+    shader.setMat4("lightSpace", lightSpace);
+    for (int i = 0; i < characters; i++)
+    {
+      shader.setMat4("model", modelMatrices[i]);
+      if (path == COMPUTE_SKINNING)
+      {
+        skinnings[i].Draw(shader);
+      }
+      else
+      {
+        bonePalette.Bind(i);
+        ourModel.Draw(shader);
+      }
+    }
+  };
+
+  // one frame: skinning and passes, timed on the GPU; returns the GPU milliseconds
+  unsigned int timerQuery;
+  glGenQueries(1, &timerQuery);
+  auto renderFrame = [&](SkinningPath path, int passes)
+  {
+    world.UpdateAnimation(deltaTime);
+    bonePalette.UploadCharacters(0, world.GetPalettes(), characters);
+
+    glBeginQuery(GL_TIME_ELAPSED, timerQuery);
+    if (path == COMPUTE_SKINNING)
+    {
+      for (int i = 0; i < characters; i++)
+        skinnings[i].skin(*skinningShader, bonePalette, i);
+      ComputeSkinning::barrier();
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+    glm::mat4 view = camera.GetViewMatrix();
+    Shader &depthShader = path == COMPUTE_SKINNING ? staticDepthShader : skinnedDepthShader;
+    Shader &mainShader = path == COMPUTE_SKINNING ? staticShader : skinnedShader;
+    if (passes >= 3)
+    {
+      glViewport(0, 0, SHADOW_SIZE, SHADOW_SIZE);
+      glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      drawCrowd(path, depthShader, lightSpace, glm::mat4(1.0f));
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+    }
+
+    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (passes >= 2)
+    {
+      // depth prepass: the main pass then only shades visible fragments
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      drawCrowd(path, depthShader, projection, view);
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      glDepthFunc(GL_LEQUAL);
+      glDepthMask(GL_FALSE);
+    }
+    mainShader.use();
+    mainShader.setBool("useShadows", passes >= 3);
+    mainShader.setInt("shadowMap", SHADOW_UNIT);
+    GLStateCache::get().bindTexture(SHADOW_UNIT, shadowMap);
+    drawCrowd(path, mainShader, projection, view);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glEndQuery(GL_TIME_ELAPSED);
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(timerQuery, GL_QUERY_RESULT, &elapsed);
+    return elapsed / 1e6;
+  };
+
+  // benchmark every path with one to three passes
+  // ------------------------------------------------
+  deltaTime = 1.0f / 60.0f;
+  std::cout << characters << " characters, " << ourModel.GetBoneCount() << " bones" << std::endl;
+  for (int passes = 1; passes <= 3; passes++)
+  {
+    for (int path = VERTEX_SHADER_SKINNING; path <= (computeAvailable ? COMPUTE_SKINNING : VERTEX_SHADER_SKINNING); path++)
+    {
+      double gpuMs = 0.0;
+      auto start = std::chrono::steady_clock::now();
+      for (int frame = 0; frame < WARMUP_FRAMES + BENCHMARK_FRAMES; frame++)
+      {
+        if (frame == WARMUP_FRAMES)
+        {
+          gpuMs = 0.0;
+          start = std::chrono::steady_clock::now();
+        }
+        gpuMs += renderFrame((SkinningPath)path, passes);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+      }
+      double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      std::cout << passes << " pass" << (passes > 1 ? "es" : "") << ", " << pathNames[path] << " skinning: "
+                << gpuMs / BENCHMARK_FRAMES << " ms GPU, " << cpuMs / BENCHMARK_FRAMES << " ms per frame" << std::endl;
+    }
+  }
+
+  // the compute result of character 0 against the CPU reference
+  if (skinningShader)
+  {
+    renderFrame(COMPUTE_SKINNING, 1);
+    std::vector<Vertex> vertices(skinnings[0].getVertexCount());
+    for (size_t i = 0; i < ourModel.meshes.size(); i++)
+      std::copy(ourModel.meshes[i].vertices.begin(), ourModel.meshes[i].vertices.end(),
+                vertices.begin() + ourModel.pack.ranges[i].baseVertex);
+    std::vector<SkinnedVertex> expected, skinned;
+    skinVerticesReference(ourModel.vertexFormat, vertices.data(), vertices.size(), world.GetPalette(0),
+                          AnimationWorld::MAX_BONES, expected);
+    skinnings[0].readBack(skinned);
+    float positionError = 0.0f, normalError = 0.0f;
+    for (size_t v = 0; v < skinned.size(); v++)
+    {
+      positionError = std::max(positionError, glm::length(skinned[v].Position - expected[v].Position));
+      normalError = std::max(normalError, glm::length(skinned[v].Normal - expected[v].Normal));
+    }
+    std::cout << "compute vs CPU reference: max position error " << positionError << ", max normal error "
+              << normalError << std::endl;
+  }
+
+  // GPU time per frame, averaged and printed once a second
+  double gpuMs = 0.0;
+  int frames = 0;
+  float lastReport = static_cast<float>(glfwGetTime());
+  lastFrame = lastReport;
+
+  // render loop
+  // -----------
+  while (!glfwWindowShouldClose(window))
+  {
+    // per-frame time logic
+    // --------------------
+    float currentFrame = static_cast<float>(glfwGetTime());
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+
+    // input
+    // -----
+    processInput(window);
+    if (!computeAvailable)
+      skinningPath = VERTEX_SHADER_SKINNING;
+
+    gpuMs += renderFrame(skinningPath, passCount);
+    frames++;
+    if (currentFrame - lastReport >= 1.0f)
+    {
+      std::cout << pathNames[skinningPath] << " skinning, " << passCount << " passes: " << gpuMs / frames << " ms GPU"
+                << std::endl;
+      gpuMs = 0.0;
+      frames = 0;
+      lastReport = currentFrame;
+    }
+
+    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    // -------------------------------------------------------------------------------
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+  }
+
+  delete skinningShader;
+  glDeleteQueries(1, &timerQuery);
+  GLStateCache::get().forgetTexture(shadowMap);
+  glDeleteTextures(1, &shadowMap);
+  glDeleteFramebuffers(1, &shadowFBO);
+  skinnings.clear();
+
+  // glfw: terminate, clearing all previously allocated GLFW resources.
+  // ------------------------------------------------------------------
+  glfwTerminate();
+  return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    glfwSetWindowShouldClose(window, true);
+
+  if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    camera.ProcessKeyboard(FORWARD, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    camera.ProcessKeyboard(BACKWARD, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    camera.ProcessKeyboard(LEFT, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    camera.ProcessKeyboard(RIGHT, deltaTime);
+
+  bool cDown = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+  if (cDown && !cPressed)
+    skinningPath = skinningPath == COMPUTE_SKINNING ? VERTEX_SHADER_SKINNING : COMPUTE_SKINNING;
+  cPressed = cDown;
+  for (int passes = 1; passes <= 3; passes++)
+    if (glfwGetKey(window, GLFW_KEY_0 + passes) == GLFW_PRESS)
+      passCount = passes;
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+  // make sure the viewport matches the new window dimensions; note that width and
+  // height will be significantly larger than specified on retina displays.
+  glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow *window, double xpos, double ypos)
+{
+  if (firstMouse)
+  {
+    lastX = xpos;
+    lastY = ypos;
+    firstMouse = false;
+  }
+
+  float xoffset = xpos - lastX;
+  float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+  lastX = xpos;
+  lastY = ypos;
+
+  camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
+{
+  camera.ProcessMouseScroll(yoffset);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// shadow and depth prepass: only depth is written
+void main()
+{
+}
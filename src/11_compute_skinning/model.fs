@@ -0,0 +1,21 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec4 LightSpacePos;
+
+uniform sampler2D texture_diffuse1;
+uniform sampler2D shadowMap;
+uniform bool useShadows;
+
+void main()
+{
+    float light = 1.0;
+    if (useShadows)
+    {
+        vec3 coords = LightSpacePos.xyz / LightSpacePos.w * 0.5 + 0.5;
+        if (coords.z <= 1.0 && coords.z - 0.002 > texture(shadowMap, coords.xy).r)
+            light = 0.4;
+    }
+    FragColor = vec4(texture(texture_diffuse1, TexCoords).rgb * light, 1.0);
+}
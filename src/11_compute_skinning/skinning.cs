@@ -0,0 +1,103 @@
+#version 430 core
+layout(local_size_x = 64) in;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+layout(std140) uniform BonePalette
+{
+    mat4 finalBonesMatrices[MAX_BONES];
+};
+
+// the packed model's vertex buffer as words: CompactSkinnedVertex (9 words) or Vertex (22)
+layout(std430, binding = 0) readonly buffer Source
+{
+    uint source[];
+};
+
+// CompactStaticVertex (7 words) per vertex, drawn from by every pass of the frame
+layout(std430, binding = 1) writeonly buffer Target
+{
+    uint target[];
+};
+
+uniform int vertexCount;
+uniform bool compactSource;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+uint octEncode(vec3 v)
+{
+    v /= abs(v.x) + abs(v.y) + abs(v.z);
+    vec2 e = v.xy;
+    if (v.z < 0.0)
+        e = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return packSnorm2x16(e);
+}
+
+vec3 readVec3(uint word)
+{
+    return vec3(uintBitsToFloat(source[word]), uintBitsToFloat(source[word + 1]), uintBitsToFloat(source[word + 2]));
+}
+
+void main()
+{
+    uint vertex = gl_GlobalInvocationID.x;
+    if (vertex >= uint(vertexCount))
+        return;
+
+    vec3 position, normal, tangent, bitangent;
+    uint texCoords;
+    ivec4 boneIds;
+    vec4 weights;
+    if (compactSource)
+    {
+        uint word = vertex * 9u;
+        position = readVec3(word);
+        normal = octDecode(unpackSnorm2x16(source[word + 3u]));
+        texCoords = source[word + 4u];
+        tangent = octDecode(unpackSnorm2x16(source[word + 5u]));
+        bitangent = octDecode(unpackSnorm2x16(source[word + 6u]));
+        uint ids = source[word + 7u];
+        boneIds = ivec4(ids & 0xffu, (ids >> 8) & 0xffu, (ids >> 16) & 0xffu, ids >> 24);
+        weights = unpackUnorm4x8(source[word + 8u]);
+    }
+    else
+    {
+        uint word = vertex * 22u;
+        position = readVec3(word);
+        normal = readVec3(word + 3u);
+        texCoords = packHalf2x16(vec2(uintBitsToFloat(source[word + 6u]), uintBitsToFloat(source[word + 7u])));
+        tangent = readVec3(word + 8u);
+        bitangent = readVec3(word + 11u);
+        boneIds = ivec4(source[word + 14u], source[word + 15u], source[word + 16u], source[word + 17u]);
+        weights = uintBitsToFloat(uvec4(source[word + 18u], source[word + 19u], source[word + 20u], source[word + 21u]));
+    }
+
+    // same blend as anim_model.vs, see skinningMatrix in compute_skinning.h
+    mat4 skinMatrix = mat4(0.0);
+    float skinnedWeight = 0.0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        float weight = boneIds[i] >= 0 && boneIds[i] < MAX_BONES ? weights[i] : 0.0;
+        skinMatrix += finalBonesMatrices[clamp(boneIds[i], 0, MAX_BONES - 1)] * weight;
+        skinnedWeight += weight;
+    }
+    skinMatrix += mat4(1.0 - skinnedWeight);
+    mat3 rotation = mat3(skinMatrix);
+
+    uint word = vertex * 7u;
+    vec3 skinned = (skinMatrix * vec4(position, 1.0)).xyz;
+    target[word] = floatBitsToUint(skinned.x);
+    target[word + 1u] = floatBitsToUint(skinned.y);
+    target[word + 2u] = floatBitsToUint(skinned.z);
+    target[word + 3u] = octEncode(normalize(rotation * normal));
+    target[word + 4u] = texCoords;
+    target[word + 5u] = octEncode(normalize(rotation * tangent));
+    target[word + 6u] = octEncode(normalize(rotation * bitangent));
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout(location = 0) in vec3 pos; // already skinned by skinning.cs
+layout(location = 2) in vec2 tex;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+uniform mat4 lightSpace;
+
+out vec2 TexCoords;
+out vec4 LightSpacePos;
+
+void main()
+{
+    vec4 worldPos = model * vec4(pos, 1.0);
+    gl_Position = projection * view * worldPos;
+    LightSpacePos = lightSpace * worldPos;
+    TexCoords = tex;
+}
@@ -0,0 +1,124 @@
+// Headless allocation check: counts every operator new while animators play the mixamo
+// clips and fails if updating a pose allocates once the animators are warmed up, on the
+// per bone glm path, the pose kernel and a blend tree. The clips are loaded while their
+// Model exists and played after it is gone, so they must not refer back to it.
+//
+//   12_animation_allocations [frames]
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/animation.h>
+#include <learnopengl/animator.h>
+#include <learnopengl/blend_tree.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// settings
+const int DEFAULT_FRAMES = 600;
+const int WARMUP_FRAMES = 10;
+const float FRAME_TIME = 1.0f / 60.0f;
+
+// every allocation of the program goes through these
+static std::atomic<long> allocations(0);
+
+void *operator new(std::size_t size)
+{
+  allocations++;
+  if (void *memory = std::malloc(size ? size : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+  allocations++;
+  std::size_t align = (std::size_t)alignment;
+  if (void *memory = std::aligned_alloc(align, (size + align - 1) / align * align))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+
+// runs update for WARMUP_FRAMES, then counts the allocations of another frames calls
+template <typename Update>
+long countAllocations(int frames, Update update)
+{
+  for (int frame = 0; frame < WARMUP_FRAMES; frame++)
+    update(frame);
+  long before = allocations.load();
+  for (int frame = 0; frame < frames; frame++)
+    update(WARMUP_FRAMES + frame);
+  return allocations.load() - before;
+}
+
+int main(int argc, char **argv)
+{
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : DEFAULT_FRAMES;
+
+  // load the clips, then let the skeleton go: the clips keep their own bone ids
+  // -----------
+  std::vector<std::unique_ptr<Animation>> clips;
+  int boneCount = 0;
+  {
+    Model skeleton = Model::loadSkeleton(FileSystem::getPath("resources/objects/mixamo_2/kachujin.dae"));
+    for (const char *clip : { "idle", "walk", "run" })
+      clips.push_back(std::make_unique<Animation>(
+        FileSystem::getPath(std::string("resources/objects/mixamo_2/") + clip + ".dae"), &skeleton));
+    boneCount = skeleton.GetBoneCount();
+  }
+  int failures = 0;
+  for (const std::unique_ptr<Animation> &clip : clips)
+    for (const auto &bone : clip->GetBoneIDMap())
+      if (bone.second.id < 0 || bone.second.id >= boneCount)
+        failures++;
+  std::cout << boneCount << " bones, " << frames << " frames, " << PoseKernelName() << " pose kernel" << std::endl;
+  std::cout << "bone maps after the model is gone: " << (failures ? "FAILED" : "passed") << std::endl;
+
+  auto report = [&](const char *name, long count)
+  {
+    std::cout << name << ": " << count << " allocations" << (count ? ", FAILED" : "") << std::endl;
+    if (count)
+      failures++;
+  };
+
+  for (bool kernel : { false, true })
+  {
+    Animator::s_UsePoseKernel = kernel;
+    std::string path = kernel ? "pose kernel" : "glm path";
+
+    Animator single(clips[0].get());
+    report((path + ", one clip").c_str(), countAllocations(frames, [&](int) { single.UpdateAnimation(FRAME_TIME); }));
+
+    Animator blended(clips[0].get());
+    blended.PlayAnimation(clips[0].get(), clips[1].get(), 0.0f, 0.0f, 0.5f);
+    report((path + ", two clips").c_str(), countAllocations(frames, [&](int) { blended.UpdateAnimation(FRAME_TIME); }));
+  }
+
+  // idle fading to walk and on to run while the tree plays
+  BlendTree tree(clips[0].get());
+  int idle = tree.AddClip(0, clips[0].get(), 1.0f);
+  int walk = tree.AddClip(0, clips[1].get());
+  int run = tree.AddClip(0, clips[2].get());
+  Animator treeAnimator(clips[0].get());
+  treeAnimator.PlayBlendTree(&tree);
+  report("blend tree, cross-fades", countAllocations(frames, [&](int frame)
+  {
+    if (frame % 120 == 0)
+      tree.CrossFade(frame % 360 == 0 ? idle : frame % 360 == 120 ? walk : run, 0.5f);
+    treeAnimator.UpdateAnimation(FRAME_TIME);
+  }));
+
+  return failures ? 1 : 0;
+}
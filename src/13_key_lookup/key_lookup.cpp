@@ -0,0 +1,141 @@
+// Headless key lookup benchmark: samples synthetic bone tracks the way a playing clip
+// does, once keeping a Bone::Cursor across frames so the segment found last frame is
+// tried first, once with a fresh cursor every time, which is a plain binary search, and
+// once with the linear scan from the first key that Bone used before it had cursors.
+// All three have to find the same keys; the program fails if they don't.
+//
+//   13_key_lookup [frames]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/bone.h>
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// settings
+const int DEFAULT_FRAMES = 2000;
+const int BONES = 60;
+const float TICKS_PER_FRAME = 0.5f; // 30 keys per second played at 60 frames per second
+const int KEY_COUNTS[] = { 8, 64, 512, 4096 };
+
+// a bone with keys at every tick, moving along a random walk
+Bone makeBone(int id, int keys, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> step(-0.1f, 0.1f);
+  std::vector<KeyPosition> positions;
+  std::vector<KeyRotation> rotations;
+  std::vector<KeyScale> scales;
+  glm::vec3 position(0.0f);
+  glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+  for (int key = 0; key < keys; key++)
+  {
+    position += glm::vec3(step(random), step(random), step(random));
+    rotation = glm::normalize(rotation * glm::quat(1.0f, step(random), step(random), step(random)));
+    positions.push_back({ position, (float)key });
+    rotations.push_back({ rotation, (float)key });
+    scales.push_back({ glm::vec3(1.0f + step(random)), (float)key });
+  }
+  return Bone("bone" + std::to_string(id), id, positions, rotations, scales);
+}
+
+enum class Lookup
+{
+  Cached,       // one Bone::Cursor per bone, kept across frames
+  BinarySearch, // a cursor that matches nothing for every sample
+  LinearScan    // the old GetPositionIndex: walk from the first key on every call
+};
+
+// the segment containing time, found as Bone did before cursors; times are below the last key
+template <typename Key>
+int linearScan(const std::vector<Key> &keys, float time)
+{
+  for (int index = 0; index < (int)keys.size() - 1; ++index)
+  {
+    if (time < keys[index + 1].timeStamp)
+      return index;
+  }
+  return (int)keys.size() - 2;
+}
+
+// the components at time with the keys found by linearScan, interpolated as Bone::Sample does
+void sampleLinear(const Bone &bone, float time, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale)
+{
+  int p = linearScan(bone.m_Positions, time), r = linearScan(bone.m_Rotations, time), s = linearScan(bone.m_Scales, time);
+  position = glm::mix(bone.m_Positions[p].position, bone.m_Positions[p + 1].position,
+                      Bone::GetScaleFactor(bone.m_Positions[p].timeStamp, bone.m_Positions[p + 1].timeStamp, time));
+  rotation = glm::normalize(glm::slerp(bone.m_Rotations[r].orientation, bone.m_Rotations[r + 1].orientation,
+                                       Bone::GetScaleFactor(bone.m_Rotations[r].timeStamp, bone.m_Rotations[r + 1].timeStamp, time)));
+  scale = glm::mix(bone.m_Scales[s].scale, bone.m_Scales[s + 1].scale,
+                   Bone::GetScaleFactor(bone.m_Scales[s].timeStamp, bone.m_Scales[s + 1].timeStamp, time));
+}
+
+// samples every bone at every time with lookup; returns ns per sample
+double sampleAll(const std::vector<Bone> &bones, const std::vector<float> &times, Lookup lookup, glm::vec3 &checksum)
+{
+  std::vector<Bone::Cursor> cursors(bones.size());
+  glm::vec3 position, scale;
+  glm::quat rotation;
+  auto start = std::chrono::steady_clock::now();
+  for (float time : times)
+    for (size_t i = 0; i < bones.size(); i++)
+    {
+      if (lookup == Lookup::LinearScan)
+        sampleLinear(bones[i], time, position, rotation, scale);
+      else
+      {
+        if (lookup == Lookup::BinarySearch)
+          cursors[i] = { INT_MAX, INT_MAX, INT_MAX };
+        bones[i].Sample(time, cursors[i], position, rotation, scale);
+      }
+      checksum += position + scale + glm::vec3(rotation.x, rotation.y, rotation.z);
+    }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return ns / (times.size() * bones.size());
+}
+
+int main(int argc, char **argv)
+{
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : DEFAULT_FRAMES;
+  std::mt19937 random(1);
+  bool failed = false;
+
+  std::cout << BONES << " bones, " << frames << " frames" << std::endl;
+  for (int keys : KEY_COUNTS)
+  {
+    std::vector<Bone> bones;
+    for (int id = 0; id < BONES; id++)
+      bones.push_back(makeBone(id, keys, random));
+
+    // playback loops over the clip; seeks jump to random times
+    float duration = (float)(keys - 1);
+    std::vector<float> playback(frames), seeks(frames);
+    std::uniform_real_distribution<float> anyTime(0.0f, duration);
+    for (int frame = 0; frame < frames; frame++)
+    {
+      playback[frame] = std::fmod(frame * TICKS_PER_FRAME, duration);
+      seeks[frame] = anyTime(random);
+    }
+
+    for (const std::vector<float> *times : { &playback, &seeks })
+    {
+      glm::vec3 cachedSum(0.0f), searchedSum(0.0f), scannedSum(0.0f);
+      double cachedNs = sampleAll(bones, *times, Lookup::Cached, cachedSum);
+      double searchedNs = sampleAll(bones, *times, Lookup::BinarySearch, searchedSum);
+      double scannedNs = sampleAll(bones, *times, Lookup::LinearScan, scannedSum);
+      bool same = cachedSum == searchedSum && cachedSum == scannedSum;
+      failed |= !same;
+      std::cout << keys << " keys, " << (times == &playback ? "playback" : "seeks") << ": cached " << cachedNs
+                << " ns, binary search " << searchedNs << " ns, linear scan " << scannedNs << " ns per bone, "
+                << scannedNs / cachedNs << "x the cached time" << (same ? "" : ", keys DIFFER") << std::endl;
+    }
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+// Headless pose kernel check: evaluates synthetic clips with the structure of arrays
+// kernel (Bone::GatherKeys, InterpolatePoses, ComposeMatrices) and with the per bone glm
+// path (Bone::Evaluate, and glm::mix/glm::slerp between two clips as Animator blends),
+// for skeletons that are and aren't a multiple of POSE_LANES. Fails if a matrix differs
+// by more than TOLERANCE or the kernel writes past the last bone.
+//
+// The instruction set is chosen at compile time, see pose_kernel.h; CMake builds this
+// as 14_pose_kernel_check (SSE2 on x86-64), 14_pose_kernel_check_avx (-mavx) and
+// 14_pose_kernel_check_scalar (POSE_KERNEL_SCALAR).
+//
+//   14_pose_kernel_check [frames]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/bone.h>
+#include <learnopengl/pose_kernel.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// settings
+const int DEFAULT_FRAMES = 300;
+const int KEYS = 40;
+const float TICKS_PER_FRAME = 0.37f; // lands between keys, and on them now and then
+const float TOLERANCE = 2e-3f;       // nlerp with corrected weights is within 7e-4 rad of slerp
+const int NODE_COUNTS[] = { 1, 3, 4, 8, 9, 67 };
+
+// a clip of count bones, each moving along its own random walk
+std::vector<Bone> makeClip(int count, std::mt19937 &random)
+{
+  std::uniform_real_distribution<float> step(-0.2f, 0.2f), any(-1.0f, 1.0f);
+  std::vector<Bone> bones;
+  for (int id = 0; id < count; id++)
+  {
+    std::vector<KeyPosition> positions;
+    std::vector<KeyRotation> rotations;
+    std::vector<KeyScale> scales;
+    glm::vec3 position(any(random), any(random), any(random));
+    glm::quat rotation = glm::normalize(glm::quat(any(random), any(random), any(random), any(random)));
+    for (int key = 0; key < KEYS; key++)
+    {
+      position += glm::vec3(step(random), step(random), step(random));
+      rotation = glm::normalize(rotation * glm::quat(1.0f, step(random), step(random), step(random)));
+      // every other key stores the same rotation negated, the kernel has to take the short arc
+      positions.push_back({ position, (float)key });
+      rotations.push_back({ key % 2 ? -rotation : rotation, (float)key });
+      scales.push_back({ glm::vec3(1.0f) + 0.5f * glm::vec3(step(random), step(random), step(random)), (float)key });
+    }
+    bones.push_back(Bone("bone" + std::to_string(id), id, positions, rotations, scales));
+  }
+  return bones;
+}
+
+float maxDifference(const glm::mat4 &a, const glm::mat4 &b)
+{
+  float difference = 0.0f;
+  for (int column = 0; column < 4; column++)
+  {
+    glm::vec4 delta = glm::abs(a[column] - b[column]);
+    difference = std::max(difference, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+  }
+  return difference;
+}
+
+int main(int argc, char **argv)
+{
+  int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : DEFAULT_FRAMES;
+  std::mt19937 random(1);
+  bool failed = false;
+  const glm::mat4 guard(42.0f);
+
+  std::cout << PoseKernelName() << " pose kernel, " << POSE_LANES << " lanes, " << frames << " frames" << std::endl;
+  for (int count : NODE_COUNTS)
+  {
+    std::vector<Bone> clip1 = makeClip(count, random), clip2 = makeClip(count, random);
+    std::vector<Bone::Cursor> glmCursors1(count), glmCursors2(count), kernelCursors1(count), kernelCursors2(count);
+
+    PoseSoA from, to, pose1, pose2;
+    PoseWeights keyWeights, blendWeights;
+    for (PoseSoA *pose : { &from, &to, &pose1, &pose2 })
+      pose->Resize(count);
+    keyWeights.Resize(from);
+    blendWeights.Resize(from);
+    std::vector<glm::mat4> matrices(count + 1);
+
+    float singleError = 0.0f, blendError = 0.0f;
+    bool overrun = false;
+    for (int frame = 0; frame < frames; frame++)
+    {
+      float time1 = std::fmod(frame * TICKS_PER_FRAME, KEYS - 1.0f);
+      float time2 = std::fmod(frame * TICKS_PER_FRAME * 1.5f, KEYS - 1.0f);
+      float blend = std::fmod(frame * 0.013f, 1.0f);
+
+      // one clip
+      for (int i = 0; i < count; i++)
+        clip1[i].GatherKeys(time1, kernelCursors1[i], from, to, keyWeights, i);
+      InterpolatePoses(from, to, keyWeights, pose1);
+      matrices[count] = guard;
+      ComposeMatrices(pose1, matrices.data());
+      overrun |= matrices[count] != guard;
+      for (int i = 0; i < count; i++)
+        singleError = std::max(singleError, maxDifference(matrices[i], clip1[i].Evaluate(time1, glmCursors1[i])));
+
+      // two clips blended
+      for (int i = 0; i < count; i++)
+        clip2[i].GatherKeys(time2, kernelCursors2[i], from, to, keyWeights, i);
+      InterpolatePoses(from, to, keyWeights, pose2);
+      blendWeights.Fill(blend);
+      InterpolatePoses(pose1, pose2, blendWeights, pose1);
+      matrices[count] = guard;
+      ComposeMatrices(pose1, matrices.data());
+      overrun |= matrices[count] != guard;
+      for (int i = 0; i < count; i++)
+      {
+        glm::vec3 position1, position2, scale1, scale2;
+        glm::quat rotation1, rotation2;
+        clip1[i].Sample(time1, glmCursors1[i], position1, rotation1, scale1);
+        clip2[i].Sample(time2, glmCursors2[i], position2, rotation2, scale2);
+        glm::mat4 expected = glm::translate(glm::mat4(1.0f), glm::mix(position1, position2, blend)) *
+                             glm::toMat4(glm::normalize(glm::slerp(rotation1, rotation2, blend))) *
+                             glm::scale(glm::mat4(1.0f), glm::mix(scale1, scale2, blend));
+        blendError = std::max(blendError, maxDifference(matrices[i], expected));
+      }
+    }
+
+    bool passed = singleError <= TOLERANCE && blendError <= TOLERANCE && !overrun;
+    failed |= !passed;
+    std::cout << count << " bones: max difference " << singleError << " for one clip, " << blendError
+              << " for two clips" << (overrun ? ", wrote past the last bone" : "") << (passed ? "" : ", FAILED")
+              << std::endl;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+// Headless check of the CPU reference skinner that 11_compute_skinning compares the
+// compute shader against. For the Full and CompactSkinned vertex formats it checks that
+// identity bones give back the input, that vertices whose weights sum to one match the
+// blend anim_model.vs used to compute, and that weight given to an id outside the palette
+// leaves that share of the vertex unskinned. So does weight missing from a sum of one in
+// the Full format; CompactSkinned stores weights normalized, spreading it over the bones.
+//
+//   15_skinning_reference [vertices]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/compute_skinning.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// settings
+const int DEFAULT_VERTICES = 10000;
+const int BONES = 100;
+// positions are stored as floats in both formats, the compact weights in 8 bits: each
+// off by up to half a step of 1/255, times skinned positions up to about 3.5 long
+const float FULL_TOLERANCE = 1e-5f;
+const float COMPACT_TOLERANCE = 3e-2f;
+const float NORMAL_TOLERANCE = 1e-3f;
+
+std::mt19937 generator(1);
+std::uniform_real_distribution<float> any(-1.0f, 1.0f);
+
+glm::vec3 randomDirection()
+{
+  return glm::normalize(glm::vec3(any(generator), any(generator), any(generator)) + glm::vec3(0.0f, 0.0f, 2.0f));
+}
+
+// a vertex skinned by influences bones of the palette with weights summing to weightSum
+Vertex makeVertex(int influences, float weightSum)
+{
+  Vertex vertex;
+  vertex.Position = glm::vec3(any(generator), any(generator), any(generator));
+  vertex.Normal = randomDirection();
+  vertex.TexCoords = glm::vec2(0.5f + 0.5f * any(generator), 0.5f + 0.5f * any(generator));
+  vertex.Tangent = randomDirection();
+  vertex.Bitangent = randomDirection();
+  float total = 0.0f;
+  for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+  {
+    vertex.m_BoneIDs[i] = i < influences ? (int)(std::abs(any(generator)) * (BONES - 1)) : -1;
+    vertex.m_Weights[i] = i < influences ? 0.1f + std::abs(any(generator)) : 0.0f;
+    total += vertex.m_Weights[i];
+  }
+  for (int i = 0; i < influences; i++)
+    vertex.m_Weights[i] *= weightSum / total;
+  return vertex;
+}
+
+// what anim_model.vs computed before the shared skinningMatrix: unused slots skipped and
+// the weighted bone positions summed, so only right for weights summing to one
+glm::vec3 previousShaderPosition(const Vertex &vertex, const std::vector<glm::mat4> &bones)
+{
+  glm::vec4 total(0.0f);
+  for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    if (vertex.m_BoneIDs[i] != -1)
+      total += bones[vertex.m_BoneIDs[i]] * glm::vec4(vertex.Position, 1.0f) * vertex.m_Weights[i];
+  return glm::vec3(total);
+}
+
+// runs skinVerticesReference in format and returns the largest position error against expected
+float positionError(VertexFormat format, const std::vector<Vertex> &vertices, const std::vector<glm::mat4> &bones,
+                    const std::vector<glm::vec3> &expected, float *normalError = nullptr)
+{
+  std::vector<SkinnedVertex> skinned;
+  skinVerticesReference(format, vertices.data(), vertices.size(), bones.data(), (int)bones.size(), skinned);
+  float error = 0.0f;
+  for (size_t v = 0; v < vertices.size(); v++)
+  {
+    error = std::max(error, glm::length(skinned[v].Position - expected[v]));
+    if (normalError)
+      *normalError = std::max(*normalError, glm::length(skinned[v].Normal - vertices[v].Normal));
+  }
+  return error;
+}
+
+int main(int argc, char **argv)
+{
+  int count = argc > 1 ? std::max(1, std::atoi(argv[1])) : DEFAULT_VERTICES;
+  bool failed = false;
+  auto report = [&](VertexFormat format, const char *name, float error, float tolerance)
+  {
+    bool passed = error <= tolerance;
+    failed |= !passed;
+    std::cout << (format == VertexFormat::Full ? "full" : "compact") << ", " << name << ": max error " << error
+              << (passed ? "" : ", FAILED") << std::endl;
+  };
+
+  std::vector<glm::mat4> identity(BONES, glm::mat4(1.0f)), bones(BONES);
+  for (glm::mat4 &bone : bones)
+    bone = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(any(generator), any(generator), any(generator))),
+                       3.0f * any(generator), randomDirection());
+
+  std::vector<Vertex> weighted, partial, outside;
+  std::vector<glm::vec3> input, previous, partialExpected, partialNormalized, outsideExpected;
+  for (int v = 0; v < count; v++)
+  {
+    weighted.push_back(makeVertex(1 + v % MAX_BONE_INFLUENCE, 1.0f));
+    input.push_back(weighted.back().Position);
+    previous.push_back(previousShaderPosition(weighted.back(), bones));
+
+    // a quarter of the weight missing: that quarter keeps the bind position
+    partial.push_back(makeVertex(2, 0.75f));
+    partialExpected.push_back(previousShaderPosition(partial.back(), bones) + 0.25f * partial.back().Position);
+    partialNormalized.push_back(previousShaderPosition(partial.back(), bones) / 0.75f);
+
+    // the second influence points past the palette and counts as missing weight
+    outside.push_back(makeVertex(2, 1.0f));
+    Vertex &vertex = outside.back();
+    float missing = vertex.m_Weights[1];
+    vertex.m_BoneIDs[1] = BONES + 7;
+    glm::vec3 skinned = glm::vec3(bones[vertex.m_BoneIDs[0]] * glm::vec4(vertex.Position, 1.0f)) * vertex.m_Weights[0];
+    outsideExpected.push_back(skinned + missing * vertex.Position);
+  }
+
+  std::cout << count << " vertices, " << BONES << " bones" << std::endl;
+  for (VertexFormat format : { VertexFormat::Full, VertexFormat::CompactSkinned })
+  {
+    float tolerance = format == VertexFormat::Full ? FULL_TOLERANCE : COMPACT_TOLERANCE;
+    float normalError = 0.0f;
+    report(format, "identity bones", positionError(format, weighted, identity, input, &normalError), FULL_TOLERANCE);
+    report(format, "identity bones, normals", normalError, NORMAL_TOLERANCE);
+    report(format, "weights summing to one", positionError(format, weighted, bones, previous), tolerance);
+    report(format, "missing weight", positionError(format, partial, bones,
+           format == VertexFormat::Full ? partialExpected : partialNormalized), tolerance);
+    report(format, "id outside the palette", positionError(format, outside, bones, outsideExpected), tolerance);
+  }
+  return failed ? 1 : 0;
+}
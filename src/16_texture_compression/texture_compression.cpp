@@ -0,0 +1,185 @@
+// Headless check of the BC1 and BC4 encoders: compresses synthetic images (gradients,
+// noise, flat colors, sizes that aren't a multiple of 4) with compressImage, decodes the
+// blocks again following the format specification and fails if the error is larger than
+// the format allows. Then writes .ctex files and checks that loadCompressedTexture takes a
+// good one and rejects an unknown format or levels with the wrong number of blocks.
+//
+//   16_texture_compression
+
+#include <learnopengl/texture_compress.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// settings: largest root mean square error per channel, in 8 bit steps. Noise that is
+// independent per channel is the worst case for BC1's one line of colors per block; a
+// block filled with its mean color would be off by about 74.
+const double BC1_GRADIENT_TOLERANCE = 4.0;
+const double BC1_NOISE_TOLERANCE = 60.0;
+const double BC4_GRADIENT_TOLERANCE = 2.0;
+const double BC4_NOISE_TOLERANCE = 12.0;
+
+struct TestImage
+{
+  std::string name;
+  int width, height, components;
+  std::vector<unsigned char> pixels;
+};
+
+TestImage makeImage(const std::string &name, int width, int height, int components, bool noise)
+{
+  static std::mt19937 generator(1);
+  TestImage image = { name, width, height, components, std::vector<unsigned char>((size_t)width * height * components) };
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++)
+      for (int c = 0; c < components; c++)
+      {
+        int value = noise ? (int)(generator() % 256) : (x * 255 / std::max(1, width - 1) * (c + 1) + y * 255 / std::max(1, height - 1)) / (c + 2);
+        image.pixels[((size_t)y * width + x) * components + c] = (unsigned char)value;
+      }
+  return image;
+}
+
+// decodes one BC1 block into rgb, as GL does for GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+void decodeBC1(const unsigned char *block, unsigned char rgb[16][3])
+{
+  uint16_t c0 = block[0] | block[1] << 8, c1 = block[2] | block[3] << 8;
+  float palette[4][3];
+  bc::unpackRGB565(c0, palette[0]);
+  bc::unpackRGB565(c1, palette[1]);
+  for (int c = 0; c < 3; c++)
+  {
+    palette[2][c] = c0 > c1 ? (2.0f * palette[0][c] + palette[1][c]) / 3.0f : (palette[0][c] + palette[1][c]) / 2.0f;
+    palette[3][c] = c0 > c1 ? (palette[0][c] + 2.0f * palette[1][c]) / 3.0f : 0.0f;
+  }
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | (uint32_t)block[7] << 24;
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < 3; c++)
+      rgb[i][c] = (unsigned char)std::lround(palette[(indices >> (2 * i)) & 3][c]);
+}
+
+// decodes one BC4 block, as GL does for GL_COMPRESSED_RED_RGTC1
+void decodeBC4(const unsigned char *block, unsigned char red[16])
+{
+  int r0 = block[0], r1 = block[1];
+  float palette[8] = { (float)r0, (float)r1 };
+  for (int i = 2; i < 8; i++)
+    palette[i] = r0 > r1 ? ((8 - i) * r0 + (i - 1) * r1) / 7.0f : i < 6 ? ((6 - i) * r0 + (i - 1) * r1) / 5.0f : i == 6 ? 0.0f : 255.0f;
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++)
+    indices |= (uint64_t)block[2 + i] << (8 * i);
+  for (int i = 0; i < 16; i++)
+    red[i] = (unsigned char)std::lround(palette[(indices >> (3 * i)) & 7]);
+}
+
+// compresses image, checks the mip chain's sizes and returns the root mean square error of
+// its first level; -1 if the chain is malformed
+double roundTrip(const TestImage &image, uint32_t format)
+{
+  CompressedImage compressed = compressImage(image.pixels.data(), image.width, image.height, image.components, format);
+  int width = image.width, height = image.height;
+  for (const CompressedLevel &level : compressed.levels)
+  {
+    if (level.width != width || level.height != height ||
+        level.blocks.size() != (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(format))
+      return -1.0;
+    width = std::max(1, width / 2);
+    height = std::max(1, height / 2);
+  }
+  if (compressed.levels.back().width != 1 || compressed.levels.back().height != 1)
+    return -1.0;
+
+  const CompressedLevel &level = compressed.levels[0];
+  int blocksX = (level.width + 3) / 4, channels = format == TEXTURE_FORMAT_BC1 ? std::min(3, image.components) : 1;
+  double squares = 0.0;
+  for (int y = 0; y < level.height; y++)
+    for (int x = 0; x < level.width; x++)
+    {
+      const unsigned char *block = level.blocks.data() + ((size_t)(y / 4) * blocksX + x / 4) * 8;
+      int pixel = (y % 4) * 4 + x % 4;
+      unsigned char decoded[3];
+      if (format == TEXTURE_FORMAT_BC1)
+      {
+        unsigned char rgb[16][3];
+        decodeBC1(block, rgb);
+        std::copy(rgb[pixel], rgb[pixel] + 3, decoded);
+      }
+      else
+      {
+        unsigned char red[16];
+        decodeBC4(block, red);
+        decoded[0] = red[pixel];
+      }
+      for (int c = 0; c < channels; c++)
+      {
+        double error = (double)decoded[c] - image.pixels[((size_t)y * image.width + x) * image.components + c];
+        squares += error * error;
+      }
+    }
+  return std::sqrt(squares / ((double)level.width * level.height * channels));
+}
+
+int main()
+{
+  bool failed = false;
+  auto report = [&](const std::string &name, double value, double tolerance)
+  {
+    bool passed = value >= 0.0 && value <= tolerance;
+    failed |= !passed;
+    std::cout << name << ": " << (value < 0.0 ? "malformed mip chain" : "rms error " + std::to_string(value))
+              << (passed ? "" : ", FAILED") << std::endl;
+  };
+
+  for (bool noise : { false, true })
+    for (int size : { 64, 37 })
+    {
+      std::string kind = (noise ? "noise " : "gradient ") + std::to_string(size) + "x" + std::to_string(size / 2 + 1);
+      TestImage rgb = makeImage(kind, size, size / 2 + 1, 3, noise), red = makeImage(kind, size, size / 2 + 1, 1, noise);
+      report("BC1 " + kind, roundTrip(rgb, TEXTURE_FORMAT_BC1), noise ? BC1_NOISE_TOLERANCE : BC1_GRADIENT_TOLERANCE);
+      report("BC4 " + kind, roundTrip(red, TEXTURE_FORMAT_BC4), noise ? BC4_NOISE_TOLERANCE : BC4_GRADIENT_TOLERANCE);
+    }
+  TestImage flat = { "flat", 5, 3, 3, std::vector<unsigned char>(5 * 3 * 3, 0) };
+  for (size_t i = 0; i < flat.pixels.size(); i += 3)
+  {
+    flat.pixels[i] = 255;
+    flat.pixels[i + 1] = 128;
+    flat.pixels[i + 2] = 8;
+  }
+  // within rounding to 5:6:5 bits
+  report("BC1 flat color 5x3", roundTrip(flat, TEXTURE_FORMAT_BC1), 4.0);
+
+  // .ctex files: a good one loads, a bad format or block count falls back to the source
+  std::filesystem::path directory = std::filesystem::temp_directory_path();
+  std::string source = (directory / "texture_compression_source.txt").string();
+  std::string path = (directory / "texture_compression_check.ctex").string();
+  std::ofstream(source) << "stand-in for the source image";
+  TestImage image = makeImage("file", 16, 8, 3, false);
+  CompressedImage compressed = compressImage(image.pixels.data(), image.width, image.height, image.components, TEXTURE_FORMAT_BC1);
+  auto loads = [&](const CompressedImage &written)
+  {
+    CompressedImage read;
+    return saveCompressedTexture(path, source, written, false) && loadCompressedTexture(path, source, false, read) &&
+           read.format == written.format && read.levels.size() == written.levels.size();
+  };
+  CompressedImage unknownFormat = compressed, missingBlock = compressed, extraBlock = compressed;
+  unknownFormat.format = 0x1234;
+  missingBlock.levels[1].blocks.resize(missingBlock.levels[1].blocks.size() - 8);
+  extraBlock.levels.back().blocks.resize(extraBlock.levels.back().blocks.size() + 8);
+  bool fileChecks[] = { loads(compressed), !loads(unknownFormat), !loads(missingBlock), !loads(extraBlock) };
+  const char *fileNames[] = { "valid file loads", "unknown format rejected", "missing block rejected", "extra block rejected" };
+  for (int i = 0; i < 4; i++)
+  {
+    failed |= !fileChecks[i];
+    std::cout << fileNames[i] << ": " << (fileChecks[i] ? "passed" : "FAILED") << std::endl;
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(source);
+
+  return failed ? 1 : 0;
+}
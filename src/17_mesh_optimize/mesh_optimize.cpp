@@ -0,0 +1,112 @@
+// Headless check of the mesh optimization passes on a 200x200 grid wrapped around a
+// sphere: runs optimizeVertexCache, optimizeOverdraw and optimizeVertexFetch on the grid in
+// row order and with its triangles shuffled, reports ACMR/ATVR after every pass and fails
+// if the cache order isn't good enough, a later pass undoes it, or a triangle got lost,
+// duplicated or flipped on the way.
+//
+//   17_mesh_optimize
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <learnopengl/mesh_optimize.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// settings
+const int GRID_SIZE = 200;
+const float MAX_OPTIMIZED_ACMR = 0.75f;    // 0.5 is the ideal for a grid
+const float MAX_OPTIMIZED_ATVR = 1.5f;     // 1 is the ideal
+const float MAX_OVERDRAW_ACMR_LOSS = 0.05f;
+
+// every triangle as its three corner positions, starting at the smallest corner so the
+// winding is kept but the starting vertex doesn't matter, sorted
+std::vector<std::array<float, 9>> triangleSet(const std::vector<unsigned int> &indices, const std::vector<glm::vec3> &positions)
+{
+  std::vector<std::array<float, 9>> triangles;
+  for (size_t i = 0; i < indices.size(); i += 3)
+  {
+    std::array<glm::vec3, 3> corners = { positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]] };
+    auto less = [](const glm::vec3 &a, const glm::vec3 &b)
+    {
+      return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+    std::array<float, 9> triangle;
+    for (int c = 0; c < 3; c++)
+      for (int k = 0; k < 3; k++)
+        triangle[c * 3 + k] = corners[c][k];
+    triangles.push_back(triangle);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+int main()
+{
+  // the grid, its seam and poles kept as separate vertices like a typical UV sphere
+  std::vector<glm::vec3> positions;
+  std::vector<unsigned int> rowOrder;
+  for (int i = 0; i <= GRID_SIZE; i++)
+    for (int j = 0; j <= GRID_SIZE; j++)
+    {
+      float theta = glm::pi<float>() * i / GRID_SIZE, phi = 2.0f * glm::pi<float>() * j / GRID_SIZE;
+      positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+    }
+  for (int i = 0; i < GRID_SIZE; i++)
+    for (int j = 0; j < GRID_SIZE; j++)
+    {
+      unsigned int a = i * (GRID_SIZE + 1) + j, b = a + 1, c = a + GRID_SIZE + 1, d = c + 1;
+      rowOrder.insert(rowOrder.end(), { a, c, b, b, c, d });
+    }
+  std::vector<unsigned int> triangleOrder(rowOrder.size() / 3), shuffled;
+  for (size_t t = 0; t < triangleOrder.size(); t++)
+    triangleOrder[t] = (unsigned int)t;
+  std::shuffle(triangleOrder.begin(), triangleOrder.end(), std::mt19937(1));
+  for (unsigned int t : triangleOrder)
+    shuffled.insert(shuffled.end(), rowOrder.begin() + t * 3, rowOrder.begin() + t * 3 + 3);
+
+  bool failed = false;
+  std::cout << GRID_SIZE << "x" << GRID_SIZE << " grid, " << rowOrder.size() / 3 << " triangles, " << VERTEX_CACHE_SIZE
+            << " entry FIFO cache" << std::endl;
+  for (const std::vector<unsigned int> *input : { &rowOrder, &shuffled })
+  {
+    std::vector<unsigned int> indices = *input;
+    VertexCacheStats before = analyzeVertexCache(indices.data(), indices.size(), positions.size());
+    auto start = std::chrono::steady_clock::now();
+    optimizeVertexCache(indices.data(), indices.size(), positions.size());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    VertexCacheStats cache = analyzeVertexCache(indices.data(), indices.size(), positions.size());
+    optimizeOverdraw(indices.data(), indices.size(), &positions[0].x, positions.size(), sizeof(glm::vec3));
+    VertexCacheStats overdraw = analyzeVertexCache(indices.data(), indices.size(), positions.size());
+    std::vector<unsigned int> oldIndex = optimizeVertexFetch(indices.data(), indices.size(), positions.size());
+    std::vector<glm::vec3> fetchPositions = remapVertices(positions.data(), oldIndex);
+    VertexCacheStats fetch = analyzeVertexCache(indices.data(), indices.size(), fetchPositions.size());
+
+    // vertex fetch order: every index is at most one past the largest before it
+    bool firstUseOrder = oldIndex.size() == positions.size();
+    unsigned int next = 0;
+    for (unsigned int index : indices)
+    {
+      firstUseOrder &= index <= next;
+      next = std::max(next, index + 1);
+    }
+    bool sameTriangles = triangleSet(*input, positions) == triangleSet(indices, fetchPositions);
+
+    bool passed = cache.acmr <= MAX_OPTIMIZED_ACMR && cache.atvr <= MAX_OPTIMIZED_ATVR &&
+                  overdraw.acmr <= cache.acmr + MAX_OVERDRAW_ACMR_LOSS && fetch.acmr == overdraw.acmr && firstUseOrder &&
+                  sameTriangles;
+    failed |= !passed;
+    std::cout << (input == &rowOrder ? "row order" : "shuffled") << ": ACMR " << before.acmr << " -> " << cache.acmr
+              << " (overdraw " << overdraw.acmr << ", fetch " << fetch.acmr << "), ATVR " << before.atvr << " -> "
+              << fetch.atvr << ", " << ms << " ms" << (firstUseOrder ? "" : ", vertices not in first use order")
+              << (sameTriangles ? "" : ", triangles changed") << (passed ? "" : ", FAILED") << std::endl;
+  }
+  return failed ? 1 : 0;
+}
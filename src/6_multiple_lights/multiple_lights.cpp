@@ -181,6 +181,9 @@ int main()
   lightingShader.use();
   lightingShader.setInt("material.diffuse", 0);
   lightingShader.setInt("material.specular", 1);
+  // resolve the per-object uniforms once, the draw loops below set them many times a frame
+  UniformHandle lightingModelLoc = lightingShader.uniform("model");
+  UniformHandle lightCubeModelLoc = lightCubeShader.uniform("model");
 
   // render loop
   // -----------
@@ -287,7 +290,7 @@ int main()
       model = glm::translate(model, cubePositions[i]);
       float angle = 20.0f * i;
       model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-      lightingShader.setMat4("model", model);
+      lightingShader.setMat4(lightingModelLoc, model);
 
       glDrawArrays(GL_TRIANGLES, 0, 36);
     }
@@ -304,7 +307,7 @@ int main()
       model = glm::mat4(1.0f);
       model = glm::translate(model, pointLightPositions[i]);
       model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-      lightCubeShader.setMat4("model", model);
+      lightCubeShader.setMat4(lightCubeModelLoc, model);
       glDrawArrays(GL_TRIANGLES, 0, 36);
     }
 
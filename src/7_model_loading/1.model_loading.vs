@@ -1,6 +1,6 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal; // octahedral encoded, see octDecode in vertex_layout.h
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
@@ -80,9 +80,11 @@ int main()
   // -------------------------
   Shader ourShader("1.model_loading.vs", "1.model_loading.fs");
 
-  // load models
+  // load models: parsed in the background and streamed in a few meshes per frame
   // -----------
-  Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
+  Model ourModel = Model::loadAsync(FileSystem::getPath("resources/objects/backpack/backpack.obj"), false, true,
+                                     VertexFormat::CompactStatic);
+  bool packed = false;
   // draw in wireframe
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -100,6 +102,14 @@ int main()
     // -----
     processInput(window);
 
+    // upload whatever the loader has finished, at most ~2 ms per frame, then draw all meshes
+    // from one shared buffer
+    if (ourModel.streamIn(2.0) && !packed)
+    {
+      ourModel.packMeshes();
+      packed = true;
+    }
+
     // render
     // ------
     glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -127,6 +137,8 @@ int main()
     glfwPollEvents();
   }
 
+  TextureCache::get().printStats();
+
   // glfw: terminate, clearing all previously allocated GLFW resources.
   // ------------------------------------------------------------------
   glfwTerminate();
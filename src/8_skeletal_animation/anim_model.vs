@@ -1,10 +1,10 @@
 #version 330 core
 
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 norm;
+layout(location = 1) in vec2 norm; // octahedral encoded like tangent and bitangent
 layout(location = 2) in vec2 tex;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 bitangent;
+layout(location = 3) in vec2 tangent;
+layout(location = 4) in vec2 bitangent;
 layout(location = 5) in ivec4 boneIds; 
 layout(location = 6) in vec4 weights;
 
@@ -14,26 +14,27 @@ uniform mat4 model;
 
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+layout(std140) uniform BonePalette
+{
+    mat4 finalBonesMatrices[MAX_BONES];
+};
 
 out vec2 TexCoords;
 
 void main()
 {
-    vec4 totalPosition = vec4(0.0f);
+    // blend the bone matrices and transform once; ids outside the palette (-1 marks an
+    // unused slot) get weight 0, and weight missing from a sum of one stays unskinned
+    mat4 skinMatrix = mat4(0.0);
+    float skinnedWeight = 0.0;
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
-        if(boneIds[i] == -1) 
-            continue;
-        if(boneIds[i] >=MAX_BONES) 
-        {
-            totalPosition = vec4(pos,1.0f);
-            break;
-        }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
-        totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
-   }
+        float weight = boneIds[i] >= 0 && boneIds[i] < MAX_BONES ? weights[i] : 0.0;
+        skinMatrix += finalBonesMatrices[clamp(boneIds[i], 0, MAX_BONES - 1)] * weight;
+        skinnedWeight += weight;
+    }
+    skinMatrix += mat4(1.0 - skinnedWeight);
+    vec4 totalPosition = skinMatrix * vec4(pos, 1.0);
 	
     mat4 viewModel = view * model;
     gl_Position =  projection * viewModel * totalPosition;
@@ -10,6 +10,7 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
+#include <learnopengl/skinning_palette.h>
 
 #include <iostream>
 
@@ -84,6 +85,8 @@ int main()
 
   // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
   stbi_set_flip_vertically_on_load(true);
+  // block compress the character's textures once and load the .ctex files from then on
+  TextureBatch::bakeCompressed = true;
 
   // configure global opengl state
   // -----------------------------
@@ -92,11 +95,14 @@ int main()
   // build and compile shaders
   // -------------------------
   Shader ourShader("anim_model.vs", "anim_model.fs");
+  SkinningPalette bonePalette;
+  bonePalette.BindShader(ourShader.ID);
 
   // load models
   // -----------
   // idle 3.3, walk 2.06, run 0.83, punch 1.03, kick 1.6
-  Model ourModel(FileSystem::getPath("resources/objects/mixamo_2/kachujin.dae"));
+  Model ourModel(FileSystem::getPath("resources/objects/mixamo_2/kachujin.dae"), false, true, VertexFormat::CompactSkinned);
+  ourModel.packMeshes();
   Animation idleAnimation(FileSystem::getPath("resources/objects/mixamo_2/idle.dae"), &ourModel);
   Animation walkAnimation(FileSystem::getPath("resources/objects/mixamo_2/walk.dae"), &ourModel);
   Animation runAnimation(FileSystem::getPath("resources/objects/mixamo_2/run.dae"), &ourModel);
@@ -106,6 +112,7 @@ int main()
   enum AnimState charState = IDLE;
   float blendAmount = 0.0f;
   float blendRate = 0.0125f;
+  int modelLod = 0;
 
   // draw in wireframe
   // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -275,16 +282,16 @@ int main()
     ourShader.setMat4("projection", projection);
     ourShader.setMat4("view", view);
 
-    auto transforms = animator.GetFinalBoneMatrices();
-    for (int i = 0; i < transforms.size(); ++i)
-      ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+    bonePalette.Upload(0, animator.GetFinalBoneMatrices());
+    bonePalette.Bind(0);
 
     // render the loaded model
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
     model = glm::scale(model, glm::vec3(.5f, .5f, .5f));         // it's a bit too big for our scene, so scale it down
     ourShader.setMat4("model", model);
-    ourModel.Draw(ourShader);
+    modelLod = ourModel.selectLod(model, makeLodView(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT), modelLod);
+    ourModel.Draw(ourShader, modelLod);
 
     // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
     // -------------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal; // octahedral encoded, see octDecode in vertex_layout.h
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in uint instanceIndex; // 0, 1, 2, ... offset by the command's baseInstance
+
+// one matrix per drawn object, filled by IndirectRenderer::submit
+layout (std430, binding = 0) buffer ModelMatrices
+{
+    mat4 models[];
+};
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * models[instanceIndex] * vec4(aPos, 1.0);
+}
@@ -0,0 +1,271 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader_m.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/entity.h>
+#include <learnopengl/indirect_renderer.h>
+
+#include <chrono>
+#include <iostream>
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void mouse_callback(GLFWwindow *window, double xpos, double ypos);
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+
+// settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// benchmark scene: GRID_SIZE x GRID_SIZE backpacks
+const int GRID_SIZE = 100;
+const float GRID_SPACING = 5.0f;
+
+// camera
+Camera camera(glm::vec3(0.0f, 10.0f, 20.0f));
+float lastX = SCR_WIDTH / 2.0f;
+float lastY = SCR_HEIGHT / 2.0f;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// M switches between multi-draw indirect and one draw per object
+IndirectRenderer renderer;
+bool mPressed = false;
+
+int main()
+{
+  // glfw: initialize and configure
+  // ------------------------------
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  // glfw window creation
+  // --------------------
+  GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+  if (window == NULL)
+  {
+    // no GL 4.3 here: the renderer falls back to one draw per object
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+  }
+  if (window == NULL)
+  {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetCursorPosCallback(window, mouse_callback);
+  glfwSetScrollCallback(window, scroll_callback);
+
+  // tell GLFW to capture our mouse
+  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+  // glad: load all OpenGL function pointers
+  // ---------------------------------------
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+  {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return -1;
+  }
+  std::cout << "multi-draw indirect " << (IndirectRenderer::supported() ? "available" : "unavailable, drawing per object")
+            << std::endl;
+
+  // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
+  stbi_set_flip_vertically_on_load(true);
+
+  // configure global opengl state
+  // -----------------------------
+  glEnable(GL_DEPTH_TEST);
+
+  // build and compile shaders: the indirect one needs GL 4.3, the per object one doesn't
+  // -------------------------
+  Shader objectShader("model.vs", "model.fs");
+  Shader indirectShader(IndirectRenderer::supported() ? "indirect.vs" : "model.vs", "model.fs");
+
+  // load the model and pack its meshes into one buffer, which the indirect path draws from
+  // -----------
+  Model ourModel(FileSystem::getPath("resources/objects/backpack/backpack.obj"), false, false, VertexFormat::CompactStatic);
+  ourModel.packMeshes();
+
+  // the scene: a grid of backpacks, the one in the middle being the root of the others
+  Entity scene(ourModel);
+  for (int x = 0; x < GRID_SIZE; x++)
+  {
+    for (int z = 0; z < GRID_SIZE; z++)
+    {
+      if (x == GRID_SIZE / 2 && z == GRID_SIZE / 2)
+        continue;
+      scene.addChild(ourModel);
+      Entity &entity = *scene.children.back();
+      entity.transform.setLocalPosition({ (x - GRID_SIZE / 2) * GRID_SPACING, 0.0f, (z - GRID_SIZE / 2) * GRID_SPACING });
+      entity.transform.setLocalRotation({ 0.0f, (float)((x * 37 + z * 11) % 360), 0.0f });
+    }
+  }
+  scene.updateSelfAndChild();
+
+  // draw two batches once, the second one's instances start after the first's, and check
+  // that the instance buffer covers both
+  if (IndirectRenderer::supported())
+  {
+    renderer.begin();
+    for (int i = 0; i < 3; i++)
+    {
+      renderer.add(ourModel, glm::translate(glm::mat4(1.0f), glm::vec3(i * GRID_SPACING, 0.0f, 0.0f)), 0);
+      renderer.add(ourModel, glm::translate(glm::mat4(1.0f), glm::vec3(i * GRID_SPACING, 0.0f, GRID_SPACING)), 1);
+    }
+    renderer.submit(indirectShader, objectShader);
+    std::cout << "instance check (2 batches, " << renderer.instances << " instances): "
+              << (renderer.checkInstances() ? "passed" : "FAILED") << std::endl;
+    renderer.begin();
+  }
+
+  // CPU time per frame, averaged and printed once a second
+  double collectMs = 0.0, submitMs = 0.0;
+  int frames = 0;
+  float lastReport = static_cast<float>(glfwGetTime());
+
+  // render loop
+  // -----------
+  while (!glfwWindowShouldClose(window))
+  {
+    // per-frame time logic
+    // --------------------
+    float currentFrame = static_cast<float>(glfwGetTime());
+    deltaTime = currentFrame - lastFrame;
+    lastFrame = currentFrame;
+
+    // input
+    // -----
+    processInput(window);
+
+    // render
+    // ------
+    glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // view/projection transformations, the same for both shaders
+    float aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT;
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 500.0f);
+    glm::mat4 view = camera.GetViewMatrix();
+    objectShader.use();
+    objectShader.setMat4("projection", projection);
+    objectShader.setMat4("view", view);
+    indirectShader.use();
+    indirectShader.setMat4("projection", projection);
+    indirectShader.setMat4("view", view);
+
+    // cull the grid and queue what's left, then draw it all
+    auto start = std::chrono::steady_clock::now();
+    const Frustum frustum = createFrustumFromCamera(camera, aspect, glm::radians(camera.Zoom), 0.1f, 500.0f);
+    const LodView lodView = makeLodView(camera.Position, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+    unsigned int display = 0, total = 0;
+    renderer.begin();
+    scene.collectSelfAndChild(frustum, renderer, display, total, &lodView);
+    collectMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    renderer.submit(indirectShader, objectShader);
+    submitMs += renderer.submitMs;
+
+    frames++;
+    if (currentFrame - lastReport >= 1.0f)
+    {
+      std::cout << (renderer.useIndirect && IndirectRenderer::supported() ? "indirect" : "per object")
+                << ": " << display << "/" << total << " visible, " << renderer.drawCalls << " draw calls, cull+collect "
+                << collectMs / frames << " ms, submit " << submitMs / frames << " ms, "
+                << frames / (currentFrame - lastReport) << " fps" << std::endl;
+      collectMs = submitMs = 0.0;
+      frames = 0;
+      lastReport = currentFrame;
+    }
+
+    // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+    // -------------------------------------------------------------------------------
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+  }
+
+  // glfw: terminate, clearing all previously allocated GLFW resources.
+  // ------------------------------------------------------------------
+  renderer.clear();
+  glfwTerminate();
+  return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    glfwSetWindowShouldClose(window, true);
+
+  if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    camera.ProcessKeyboard(FORWARD, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    camera.ProcessKeyboard(BACKWARD, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    camera.ProcessKeyboard(LEFT, deltaTime);
+  if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    camera.ProcessKeyboard(RIGHT, deltaTime);
+
+  bool m = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+  if (m && !mPressed)
+    renderer.useIndirect = !renderer.useIndirect;
+  mPressed = m;
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+  // make sure the viewport matches the new window dimensions; note that width and
+  // height will be significantly larger than specified on retina displays.
+  glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow *window, double xposIn, double yposIn)
+{
+  float xpos = static_cast<float>(xposIn);
+  float ypos = static_cast<float>(yposIn);
+
+  if (firstMouse)
+  {
+    lastX = xpos;
+    lastY = ypos;
+    firstMouse = false;
+  }
+
+  float xoffset = xpos - lastX;
+  float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+  lastX = xpos;
+  lastY = ypos;
+
+  camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
+{
+  camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
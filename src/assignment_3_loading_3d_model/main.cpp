@@ -10,6 +10,7 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
+#include <learnopengl/skinning_palette.h>
 
 #include <iostream>
 
@@ -110,6 +111,8 @@ int main()
 
   Shader mazeShader("maze.vs", "maze.fs");
   Shader animShader("anim_model.vs", "anim_model.fs");
+  SkinningPalette bonePalette;
+  bonePalette.BindShader(animShader.ID);
   Shader playerShader("model_loading.vs", "model_loading.fs");
 
   Model playerModel(FileSystem::getPath("resources/objects/mixamo/YakuJIgnite.dae"));
@@ -198,13 +201,14 @@ int main()
     mazeMesh.draw();
 
     // ---- draw player ----
+    // the floor and maze above bind their VAO and textures with plain GL calls
+    GLStateCache::get().invalidate();
     animShader.use();
     animShader.setMat4("projection", projection);
     animShader.setMat4("view", view);
 
-    auto transforms = walkAnimator.GetFinalBoneMatrices();
-    for (int i = 0; i < transforms.size(); ++i)
-      animShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+    bonePalette.Upload(0, walkAnimator.GetFinalBoneMatrices());
+    bonePalette.Bind(0);
 
     glm::mat4 playerModelMat = glm::mat4(1.0f);
     playerModelMat = glm::translate(playerModelMat, playerPos);
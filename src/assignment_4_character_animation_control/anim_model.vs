@@ -14,26 +14,28 @@ uniform mat4 model;
 
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+layout(std140) uniform BonePalette
+{
+    mat4 finalBonesMatrices[MAX_BONES];
+};
 
 out vec2 TexCoords;
 
 void main()
 {
-    vec4 totalPosition = vec4(0.0f);
+    // blend the bone matrices and transform once; unused slots (-1) get weight 0, and an
+    // id past the palette leaves the whole vertex unskinned
+    mat4 skinMatrix = mat4(0.0);
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
-        if(boneIds[i] == -1) 
-            continue;
-        if(boneIds[i] >=MAX_BONES) 
+        if(boneIds[i] >= MAX_BONES)
         {
-            totalPosition = vec4(pos,1.0f);
+            skinMatrix = mat4(1.0);
             break;
         }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
-        totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
-   }
+        skinMatrix += finalBonesMatrices[max(boneIds[i], 0)] * (boneIds[i] >= 0 ? weights[i] : 0.0);
+    }
+    vec4 totalPosition = skinMatrix * vec4(pos, 1.0);
 	
     mat4 viewModel = view * model;
     gl_Position =  projection * viewModel * totalPosition;
@@ -10,6 +10,7 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
+#include <learnopengl/skinning_palette.h>
 
 #include <iostream>
 
@@ -50,18 +51,13 @@ float originalFollowHeight = followHeight;
 enum AnimState
 {
   IDLE = 1,
-  IDLE_WALK,
-  WALK_IDLE,
   WALK,
-  WALK_RUN,
-  RUN_WALK,
   RUN,
-  RUN_IDLE,
-  IDLE_JUMPIDLE,
-  JUMPIDLE_IDLE,
+  JUMP,
 };
 
-float SmoothStep(float t) { return t * t * (3 - 2 * t); }
+// seconds a transition between two clips takes
+float fadeSeconds = 0.4f;
 
 int main()
 {
@@ -97,6 +93,8 @@ int main()
   glEnable(GL_DEPTH_TEST);
 
   Shader ourShader("anim_model.vs", "anim_model.fs");
+  SkinningPalette bonePalette;
+  bonePalette.BindShader(ourShader.ID);
 
   Model ourModel(FileSystem::getPath("resources/objects/assignment_4/Ch42_nonPBR.dae"));
   Animation idleAnimation(FileSystem::getPath("resources/objects/assignment_4/animation/Idle.dae"), &ourModel);
@@ -104,10 +102,16 @@ int main()
   Animation runAnimation(FileSystem::getPath("resources/objects/assignment_4/animation/Running.dae"), &ourModel);
   Animation idleJumpAnimation(FileSystem::getPath("resources/objects/assignment_4/animation/IdleJump.dae"), &ourModel);
 
+  // the states are clips of the base layer; a transition cross-fades to the next one
+  BlendTree blendTree(&idleAnimation);
+  int idleClip = blendTree.AddClip(0, &idleAnimation, 1.0f);
+  int walkClip = blendTree.AddClip(0, &walkAnimation);
+  int runClip = blendTree.AddClip(0, &runAnimation);
+  int jumpClip = blendTree.AddClip(0, &idleJumpAnimation, 0.0f, false);
+
   Animator animator(&idleAnimation);
+  animator.PlayBlendTree(&blendTree);
   AnimState charState = IDLE;
-  float blendAmount = 0.0f;
-  float blendRate = 0.0075f;
 
   while (!glfwWindowShouldClose(window))
   {
@@ -124,7 +128,7 @@ int main()
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
       characterYaw += 120.0f * deltaTime;
 
-    // ---------------- Animation State Machine (Your Original) ---------------- //
+    // ---------------- Animation State Machine ---------------- //
     animator.UpdateAnimation(deltaTime);
 
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
@@ -142,138 +146,45 @@ int main()
     {
       if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
       {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleAnimation, &walkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-        charState = IDLE_WALK;
-      }
-      if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-      {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleAnimation, &idleJumpAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-        charState = IDLE_JUMPIDLE;
-      }
-      break;
-    }
-    case IDLE_WALK:
-    {
-      blendAmount += blendRate;
-      animator.PlayAnimation(&idleAnimation, &walkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, SmoothStep(blendAmount));
-      if (blendAmount > 0.9f)
-      {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&walkAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
+        blendTree.CrossFade(walkClip, fadeSeconds);
         charState = WALK;
       }
-      break;
-    }
-    case WALK:
-    {
-      if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-      {
-        characterPosition += glm::vec3(
-            sin(glm::radians(characterYaw)) * walkSpeed * deltaTime,
-            0.0f,
-            cos(glm::radians(characterYaw)) * walkSpeed * deltaTime);
-      }
-
-      animator.PlayAnimation(&walkAnimation, NULL, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-
-      if (glfwGetKey(window, GLFW_KEY_W) != GLFW_PRESS)
-        charState = WALK_IDLE;
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-        charState = WALK_RUN;
-      break;
-    }
-    case WALK_IDLE:
-    {
-      blendAmount += blendRate;
-      animator.PlayAnimation(&walkAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, SmoothStep(blendAmount));
-      if (blendAmount > 0.9f)
-      {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
-        charState = IDLE;
-      }
-      break;
-    }
-    case WALK_RUN:
-    {
-      blendAmount += blendRate;
-      animator.PlayAnimation(&walkAnimation, &runAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, SmoothStep(blendAmount));
-      if (blendAmount > 0.9f)
+      else if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
       {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&runAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
-        charState = RUN;
+        blendTree.CrossFade(jumpClip, fadeSeconds);
+        charState = JUMP;
       }
       break;
     }
-
+    case WALK:
     case RUN:
     {
-      if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-      {
-        characterPosition += glm::vec3(
-            sin(glm::radians(characterYaw)) * runSpeed * deltaTime,
-            0.0f,
-            cos(glm::radians(characterYaw)) * runSpeed * deltaTime);
-      }
-
-      animator.PlayAnimation(&runAnimation, NULL, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+      float speed = charState == RUN ? runSpeed : walkSpeed;
+      characterPosition += glm::vec3(
+          sin(glm::radians(characterYaw)) * speed * deltaTime,
+          0.0f,
+          cos(glm::radians(characterYaw)) * speed * deltaTime);
 
+      bool running = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
       if (glfwGetKey(window, GLFW_KEY_W) != GLFW_PRESS)
-        charState = RUN_IDLE;
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) != GLFW_PRESS)
-        charState = RUN_WALK;
-      break;
-    }
-    case RUN_WALK:
-    {
-      blendAmount += blendRate;
-      animator.PlayAnimation(&runAnimation, &walkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, SmoothStep(blendAmount));
-      if (blendAmount > 0.9f)
       {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&walkAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
-        charState = WALK;
-      }
-      break;
-    }
-    case RUN_IDLE:
-    {
-      blendAmount += blendRate;
-      animator.PlayAnimation(&runAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, SmoothStep(blendAmount));
-      if (blendAmount > 0.9f)
-      {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
+        blendTree.CrossFade(idleClip, fadeSeconds);
         charState = IDLE;
       }
-      break;
-    }
-    case IDLE_JUMPIDLE:
-    {
-      blendAmount += blendRate;
-      float smoothBlend = SmoothStep(glm::clamp(blendAmount, 0.0f, 1.0f));
-      animator.PlayAnimation(&idleAnimation, &idleJumpAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, smoothBlend);
-      if (smoothBlend >= 1.0f)
+      else if (running != (charState == RUN))
       {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleJumpAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
-        charState = JUMPIDLE_IDLE;
+        blendTree.CrossFade(running ? runClip : walkClip, fadeSeconds);
+        charState = running ? RUN : WALK;
       }
       break;
     }
-
-    case JUMPIDLE_IDLE:
+    case JUMP:
     {
-      blendAmount += blendRate;
-      float smoothBlend = SmoothStep(glm::clamp(blendAmount, 0.0f, 1.0f));
-      animator.PlayAnimation(&idleJumpAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, smoothBlend);
-      if (smoothBlend >= 1.0f)
+      // back to idle so that the fade ends with the jump
+      float fadeStart = 1.0f - fadeSeconds * idleJumpAnimation.GetTicksPerSecond() / idleJumpAnimation.GetDuration();
+      if (blendTree.GetNormalizedTime(jumpClip) >= fadeStart)
       {
-        blendAmount = 0.0f;
-        animator.PlayAnimation(&idleAnimation, NULL, animator.m_CurrentTime2, 0.0f, blendAmount);
+        blendTree.CrossFade(idleClip, fadeSeconds);
         charState = IDLE;
       }
       break;
@@ -314,9 +225,8 @@ int main()
     ourShader.setMat4("projection", projection);
     ourShader.setMat4("view", view);
 
-    auto transforms = animator.GetFinalBoneMatrices();
-    for (int i = 0; i < transforms.size(); ++i)
-      ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+    bonePalette.Upload(0, animator.GetFinalBoneMatrices());
+    bonePalette.Bind(0);
 
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, characterPosition);